@@ -0,0 +1,150 @@
+/*
+ * ast.c - Measures how many bytes every node of a large AST takes, and how
+ * long it takes to walk all of them.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include "bench/bench.h"
+#include "compiler.h"
+#include "helpers/vector.h"
+
+#define AST_STATEMENTS 200000
+#define AST_WALKS 10
+
+static void
+ast_write_source (FILE *f, int statements)
+{
+  for (int i = 0; i < statements; i++)
+    {
+      switch (i % 4)
+        {
+        case 0:
+          fprintf (f, "long v%d = (x + %d) * (y - z / 3) << 2\n", i, i);
+          break;
+        case 1:
+          fprintf (f, "int v%d = a < b && (c | %d) >= 0x%x\n", i, i, i);
+          break;
+        case 2:
+          fprintf (f, "double v%d = 2.5e3f / d - %d.25 * e\n", i, i);
+          break;
+        default:
+          fprintf (f, "x%d = y * (z - %d) + \"str\" + 9876543210\n", i, i);
+          break;
+        }
+    }
+}
+
+// bytes allocated for a vector, used or not
+static size_t
+ast_vector_bytes (struct vector *vector)
+{
+  return vector->mindex * vector_element_size (vector);
+}
+
+// visits every node under the roots without recursing, returns how many
+// there were
+static int
+ast_walk_once (struct compile_process *process, struct vector *stack)
+{
+  int visited = 0;
+  vector_clear (stack);
+  vector_push_multiple (stack, vector_data_ptr (process->node_tree_vec),
+                        vector_count (process->node_tree_vec));
+  while (!vector_empty (stack))
+    {
+      int node = *(int *)vector_back (stack);
+      vector_pop (stack);
+      visited++;
+
+      int children[2] = { -1, -1 };
+      switch (node_type (process, node))
+        {
+        case NODE_TYPE_EXPRESSION:
+          children[0] = node_exp (process, node)->left;
+          children[1] = node_exp (process, node)->right;
+          break;
+
+        case NODE_TYPE_EXPRESSION_PARENTHESES:
+          children[0] = node_parentheses_exp (process, node);
+          break;
+
+        case NODE_TYPE_VARIABLE:
+          children[0] = node_var (process, node)->val;
+          break;
+        }
+
+      for (int i = 0; i < 2; i++)
+        {
+          if (children[i] >= 0)
+            vector_push (stack, &children[i]);
+        }
+    }
+
+  return visited;
+}
+
+struct ast_walk
+{
+  struct compile_process *process;
+  struct vector *stack;
+  int visited;
+};
+
+static double
+ast_walk (void *private, int walks)
+{
+  struct ast_walk *walk = private;
+  double start = bench_seconds ();
+  for (int i = 0; i < walks; i++)
+    walk->visited = ast_walk_once (walk->process, walk->stack);
+
+  return bench_seconds () - start;
+}
+
+int
+main ()
+{
+  int sizes[] = { AST_STATEMENTS };
+  struct bench_sources sources;
+  bench_sources_create (&sources, sizes, 1, ast_write_source);
+
+  const char *fname = sources.fnames[0];
+  struct lex_process *lexer;
+  struct compile_process *process = bench_lex ("ast", fname, &lexer);
+  jmp_buf error_jmp;
+  process->error_jmp = &error_jmp;
+  if (setjmp (error_jmp))
+    bench_fail ("ast", "couldn't parse `%s'", fname);
+
+  parse (process);
+
+  // every node is four arrays, anything that doesn't fit in them goes to
+  // the payload of its kind
+  struct ast *ast = process->ast;
+  size_t node_bytes = sizeof (*ast->type) + sizeof (*ast->flags)
+                      + sizeof (*ast->offset) + sizeof (*ast->data);
+  size_t bytes = ast->capacity * node_bytes + ast_vector_bytes (ast->exps)
+                 + ast_vector_bytes (ast->vars)
+                 + ast_vector_bytes (ast->numbers);
+  printf ("ast: %d nodes, %zu bytes, %.1f bytes each (%zu without "
+          "payloads, a struct node is %zu)\n",
+          ast->count, bytes, (double)bytes / ast->count, node_bytes,
+          sizeof (struct node));
+
+  struct ast_walk walk = { .process = process,
+                           .stack = vector_create (sizeof (int)) };
+  double seconds = bench_best (ast_walk, &walk, AST_WALKS);
+  printf ("ast: walking every node: %.3fs, %.1fns each\n",
+          seconds / AST_WALKS, seconds / AST_WALKS / walk.visited * 1e9);
+
+  // nodes can only be reached once, and no more of them than were made
+  if (walk.visited > ast->count)
+    bench_fail ("ast", "walked %d nodes out of %d", walk.visited,
+                ast->count);
+
+  vector_free (walk.stack);
+  bench_lex_free (process, lexer);
+  bench_sources_free (&sources);
+  return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * bench.c - Shared pieces of the benchmarks and tests under bench/.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include "bench.h"
+#include "compiler.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+double
+bench_seconds ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+long
+bench_peak_rss ()
+{
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+FILE *
+bench_create_source (char **fname)
+{
+  const char *dir = getenv ("TMPDIR");
+  if (!dir || !*dir)
+    dir = "/tmp";
+
+  *fname = malloc (strlen (dir) + sizeof ("/kcc-bench-XXXXXX.c"));
+  sprintf (*fname, "%s/kcc-bench-XXXXXX.c", dir);
+
+  // the suffix is kept so the file is named like any other source
+  int fd = mkstemps (*fname, 2);
+  FILE *f = fd >= 0 ? fdopen (fd, "w") : NULL;
+  if (!f)
+    bench_fail ("bench", "couldn't create `%s'", *fname);
+
+  return f;
+}
+
+double
+bench_best (BENCH_RUN run, void *private, int size)
+{
+  double best = run (private, size);
+  for (int i = 1; i < BENCH_RUNS; i++)
+    {
+      double seconds = run (private, size);
+      if (seconds < best)
+        best = seconds;
+    }
+
+  return best;
+}
+
+void
+bench_scaling (const char *name, const char *unit, BENCH_RUN run,
+               void *private, const int *sizes, int total)
+{
+  double last = 0;
+  for (int i = 0; i < total; i++)
+    {
+      double seconds = bench_best (run, private, sizes[i]);
+      double per_unit = seconds / sizes[i];
+      printf ("%s: %d %s: %.3fs, %.1fns each\n", name, sizes[i], unit,
+              seconds, per_unit * 1e9);
+
+      if (i > 0 && per_unit > last * BENCH_MAX_SLOWDOWN)
+        bench_fail (name, "%d %s take %.1f times as long each as %d",
+                    sizes[i], unit, per_unit / last, sizes[i - 1]);
+      last = per_unit;
+    }
+}
+
+void
+bench_sources_create (struct bench_sources *sources, const int *sizes,
+                      int total, void (*write) (FILE *f, int size))
+{
+  sources->total = total;
+  sources->sizes = sizes;
+  sources->fnames = calloc (total, sizeof (char *));
+  for (int i = 0; i < total; i++)
+    {
+      FILE *f = bench_create_source (&sources->fnames[i]);
+      write (f, sizes[i]);
+      fclose (f);
+    }
+}
+
+const char *
+bench_sources_get (struct bench_sources *sources, int size)
+{
+  for (int i = 0; i < sources->total; i++)
+    {
+      if (sources->sizes[i] == size)
+        return sources->fnames[i];
+    }
+
+  return NULL;
+}
+
+void
+bench_sources_free (struct bench_sources *sources)
+{
+  for (int i = 0; i < sources->total; i++)
+    {
+      remove (sources->fnames[i]);
+      free (sources->fnames[i]);
+    }
+
+  free (sources->fnames);
+}
+
+struct compile_process *
+bench_lex (const char *name, const char *fname, struct lex_process **lexer)
+{
+  struct compile_process *process
+      = compile_process_create (fname, NULL, 0, stderr);
+  if (!process)
+    bench_fail (name, "couldn't open `%s'", fname);
+
+  jmp_buf error_jmp;
+  process->error_jmp = &error_jmp;
+  if (setjmp (error_jmp))
+    bench_fail (name, "couldn't lex `%s'", fname);
+
+  *lexer = lex_process_create (process, &compiler_mem_lex_functions, NULL);
+  (*lexer)->flags |= LEX_PROCESS_FLAG_DROP_TRIVIA;
+  lex (*lexer);
+
+  process->error_jmp = NULL;
+  process->tokens = (*lexer)->tokens;
+  process->tokens->cursor = 0;
+  process->parser.last_token = -1;
+  return process;
+}
+
+void
+bench_lex_free (struct compile_process *process, struct lex_process *lexer)
+{
+  lex_process_free (lexer);
+  compile_process_free (process);
+}
+
+void
+bench_fail (const char *name, const char *fmt, ...)
+{
+  va_list args;
+  va_start (args, fmt);
+  fprintf (stderr, "%s: FAILED: ", name);
+  vfprintf (stderr, fmt, args);
+  fprintf (stderr, "\n");
+  va_end (args);
+  exit (1);
+}
@@ -0,0 +1,102 @@
+/*
+ * bench.h - Shared pieces of the benchmarks and tests under bench/.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <stdio.h>
+
+/**
+ * Seconds on a clock that only goes forward, only differences between two
+ * calls mean anything
+ */
+double bench_seconds ();
+
+/**
+ * The most memory the process has had resident so far, in kilobytes
+ */
+long bench_peak_rss ();
+
+/**
+ * Creates a temporary source file and opens it for writing, its name goes
+ * in `fname'. The caller closes it, then removes it and frees the name
+ */
+FILE *bench_create_source (char **fname);
+
+// every timing is the best of this many tries, so a busy machine doesn't
+// make a check fail
+#define BENCH_RUNS 3
+
+// how much longer per unit of work a run may take than the one before it,
+// when the work grows four times. Work that outgrows the caches gets
+// somewhat slower, but anything quadratic takes four times as long per unit
+#define BENCH_MAX_SLOWDOWN 3
+
+/**
+ * Does `size' units of work and returns how many seconds the part worth
+ * timing took
+ */
+typedef double (*BENCH_RUN) (void *private, int size);
+
+/**
+ * The fastest of BENCH_RUNS calls to `run'
+ */
+double bench_best (BENCH_RUN run, void *private, int size);
+
+/**
+ * Times `run' for each of the `total' `sizes' of `unit's (plural, i.e.
+ * "symbols"), each four times the one before, printing the time each one
+ * took. Fails unless every one of them takes at most BENCH_MAX_SLOWDOWN
+ * times as long per unit as the one before
+ */
+void bench_scaling (const char *name, const char *unit, BENCH_RUN run,
+                    void *private, const int *sizes, int total);
+
+/**
+ * A generated source file for each size a benchmark is timed at
+ */
+struct bench_sources
+{
+  int total;
+  const int *sizes;
+  char **fnames;
+};
+
+/**
+ * Writes a file for each of the `total' `sizes' with `write'
+ */
+void bench_sources_create (struct bench_sources *sources, const int *sizes,
+                           int total, void (*write) (FILE *f, int size));
+
+/**
+ * The file that was written for `size'
+ */
+const char *bench_sources_get (struct bench_sources *sources, int size);
+
+/**
+ * Removes the files and frees their names
+ */
+void bench_sources_free (struct bench_sources *sources);
+
+struct compile_process;
+struct lex_process;
+
+/**
+ * Lexes `fname' the way compile_file does and gets it ready to be parsed,
+ * the lexer goes in `lexer'. Nothing that goes wrong here is expected, so
+ * the benchmark `name' fails on it. Both are freed with bench_lex_free
+ */
+struct compile_process *bench_lex (const char *name, const char *fname,
+                                   struct lex_process **lexer);
+void bench_lex_free (struct compile_process *process,
+                     struct lex_process *lexer);
+
+/**
+ * Prints a failed check and exits with 1
+ */
+void bench_fail (const char *name, const char *fmt, ...);
+
+#endif
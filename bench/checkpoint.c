@@ -0,0 +1,320 @@
+/*
+ * checkpoint.c - Checks that rolling the parser back to a checkpoint leaves
+ * it exactly where it was, and that trying every statement twice doesn't
+ * make parsing quadratic.
+ *
+ * Rollbacks that can't put the parser back, because something under the
+ * checkpoint was popped or a symbol was declared, have to abort.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench/bench.h"
+#include "compiler.h"
+#include "helpers/buffer.h"
+#include "helpers/vector.h"
+
+#define CHECKPOINT_STATEMENTS 200000
+
+// everything a rollback has to put back, copied out of the parser
+struct checkpoint_state
+{
+  int cursor;
+  int saves;
+  int last_token;
+
+  int nodes;
+  int tree_nodes;
+  int exp_ops;
+  int datatypes;
+  struct arena_mark arena;
+
+  // the nodes themselves and their payloads
+  struct buffer *ast;
+  int exps;
+  int vars;
+  int numbers;
+};
+
+static void
+checkpoint_copy (struct buffer *buffer, const void *data, size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+    buffer_write (buffer, ((const char *)data)[i]);
+}
+
+static void
+checkpoint_copy_vector (struct buffer *buffer, struct vector *vector)
+{
+  checkpoint_copy (buffer, vector_data_ptr (vector),
+                   vector_count (vector) * vector_element_size (vector));
+}
+
+static struct checkpoint_state
+checkpoint_state (struct compile_process *process)
+{
+  struct ast *ast = process->ast;
+  struct checkpoint_state state = {
+    .cursor = process->tokens->cursor,
+    .saves = vector_count (process->tokens->saves),
+    .last_token = process->parser.last_token,
+    .nodes = vector_count (process->node_vec),
+    .tree_nodes = vector_count (process->node_tree_vec),
+    .exp_ops = vector_count (process->parser.exp_ops),
+    .datatypes = vector_count (process->datatypes->types),
+    .arena = arena_mark (process->arena),
+    .ast = buffer_create (),
+    .exps = vector_count (ast->exps),
+    .vars = vector_count (ast->vars),
+    .numbers = vector_count (ast->numbers),
+  };
+
+  checkpoint_copy (state.ast, ast->type, ast->count);
+  checkpoint_copy (state.ast, ast->flags, ast->count);
+  checkpoint_copy (state.ast, ast->offset, ast->count * sizeof (int));
+  checkpoint_copy (state.ast, ast->data, ast->count * sizeof (int));
+  checkpoint_copy_vector (state.ast, ast->exps);
+  checkpoint_copy_vector (state.ast, ast->vars);
+  checkpoint_copy_vector (state.ast, ast->numbers);
+  checkpoint_copy_vector (state.ast, process->node_vec);
+  checkpoint_copy_vector (state.ast, process->node_tree_vec);
+  return state;
+}
+
+static void
+checkpoint_expect (struct compile_process *process,
+                   struct checkpoint_state *expected, const char *when)
+{
+  struct checkpoint_state state = checkpoint_state (process);
+  if (state.cursor != expected->cursor || state.saves != expected->saves
+      || state.last_token != expected->last_token
+      || state.nodes != expected->nodes
+      || state.tree_nodes != expected->tree_nodes
+      || state.exp_ops != expected->exp_ops
+      || state.datatypes != expected->datatypes
+      || state.arena.chunk != expected->arena.chunk
+      || state.arena.used != expected->arena.used
+      || state.exps != expected->exps || state.vars != expected->vars
+      || state.numbers != expected->numbers
+      || state.ast->len != expected->ast->len
+      || memcmp (state.ast->data, expected->ast->data, state.ast->len)
+             != 0)
+    {
+      bench_fail ("checkpoint", "the parser isn't the same %s", when);
+    }
+
+  buffer_free (state.ast);
+}
+
+// parses up to `total' statements the way parse does
+static int
+checkpoint_parse (struct compile_process *process, int total)
+{
+  int parsed = 0;
+  while (parsed < total && parse_next (process) == 0)
+    {
+      int node = node_peek (process);
+      vector_push (process->node_tree_vec, &node);
+      parsed++;
+    }
+
+  return parsed;
+}
+
+static void
+checkpoint_write_source (FILE *f, int statements)
+{
+  for (int i = 0; i < statements; i++)
+    {
+      switch (i % 5)
+        {
+        case 0:
+          fprintf (f, "long v%d = (x + %d) * 5000000000\n", i, i);
+          break;
+        case 1:
+          fprintf (f, "int v%d = a < b && (c | %d) >= 0x%x\n", i, i, i);
+          break;
+        case 2:
+          fprintf (f, "double v%d = 2.5e3f / 1.5 - %d.25\n", i, i);
+          break;
+        case 3:
+          fprintf (f, "char v%d = \"str %d\"\n", i, i);
+          break;
+        default:
+          fprintf (f, "x%d = y * (z - %d) + 4 * 1024\n", i, i);
+          break;
+        }
+    }
+}
+
+// rolls back, nested and not, and checks the parser each time
+static void
+checkpoint_test (const char *fname)
+{
+  struct lex_process *lexer;
+  struct compile_process *process = bench_lex ("checkpoint", fname, &lexer);
+  jmp_buf error_jmp;
+  process->error_jmp = &error_jmp;
+  if (setjmp (error_jmp))
+    bench_fail ("checkpoint", "couldn't parse `%s'", fname);
+
+  checkpoint_parse (process, 7);
+  struct checkpoint_state before = checkpoint_state (process);
+
+  struct parser_checkpoint outer;
+  parser_checkpoint (process, &outer);
+  checkpoint_parse (process, 5);
+  struct checkpoint_state middle = checkpoint_state (process);
+
+  struct parser_checkpoint inner;
+  parser_checkpoint (process, &inner);
+  checkpoint_parse (process, 20);
+  parser_rollback (process, &inner);
+  checkpoint_expect (process, &middle, "after an inner rollback");
+
+  parser_rollback (process, &outer);
+  checkpoint_expect (process, &before, "after a rollback");
+
+  // the same statements parsed again come out the same
+  parser_checkpoint (process, &outer);
+  checkpoint_parse (process, 5);
+  parser_commit (process, &outer);
+  middle.saves = before.saves;
+  checkpoint_expect (process, &middle, "parsing again after a rollback");
+
+  // and the rest of the file is still there
+  if (checkpoint_parse (process, 20) != 20)
+    bench_fail ("checkpoint", "statements went missing after a rollback");
+
+  buffer_free (before.ast);
+  buffer_free (middle.ast);
+  bench_lex_free (process, lexer);
+}
+
+// pops a node that was there before the checkpoint
+static void
+checkpoint_misuse_pop (struct compile_process *process)
+{
+  struct parser_checkpoint checkpoint;
+  parser_checkpoint (process, &checkpoint);
+  node_pop (process);
+  parser_rollback (process, &checkpoint);
+}
+
+// declares a symbol, which a rollback would cut out of the arena
+static void
+checkpoint_misuse_symbol (struct compile_process *process)
+{
+  struct parser_checkpoint checkpoint;
+  parser_checkpoint (process, &checkpoint);
+  symres_register_symbol (process, "checkpoint", SYMBOL_TYPE_NODE, NULL);
+  parser_rollback (process, &checkpoint);
+}
+
+// starts a symbol table and doesn't end it
+static void
+checkpoint_misuse_table (struct compile_process *process)
+{
+  struct parser_checkpoint checkpoint;
+  parser_checkpoint (process, &checkpoint);
+  symres_new_table (process);
+  parser_rollback (process, &checkpoint);
+}
+
+// runs `misuse' on a process that parsed a few statements, in a child that
+// has to abort
+static void
+checkpoint_misuse (const char *fname, const char *what,
+                   void (*misuse) (struct compile_process *process))
+{
+  fflush (stdout);
+  pid_t pid = fork ();
+  if (pid < 0)
+    bench_fail ("checkpoint", "couldn't fork");
+
+  if (pid == 0)
+    {
+      // the failed assertion is what we're after, nobody has to see it
+      freopen ("/dev/null", "w", stderr);
+      struct lex_process *lexer;
+      struct compile_process *process
+          = bench_lex ("checkpoint", fname, &lexer);
+      jmp_buf error_jmp;
+      process->error_jmp = &error_jmp;
+      if (setjmp (error_jmp))
+        _exit (1);
+
+      checkpoint_parse (process, 3);
+      misuse (process);
+      _exit (0);
+    }
+
+  int status;
+  waitpid (pid, &status, 0);
+  if (!WIFSIGNALED (status) || WTERMSIG (status) != SIGABRT)
+    bench_fail ("checkpoint", "a rollback after %s didn't abort", what);
+}
+
+// tries every statement, rolls back and parses it again for real. Returns
+// how long it took
+static double
+checkpoint_bench (void *private, int statements)
+{
+  const char *fname = bench_sources_get (private, statements);
+  struct lex_process *lexer;
+  struct compile_process *process = bench_lex ("checkpoint", fname, &lexer);
+  jmp_buf error_jmp;
+  process->error_jmp = &error_jmp;
+  if (setjmp (error_jmp))
+    bench_fail ("checkpoint", "couldn't parse `%s'", fname);
+
+  double start = bench_seconds ();
+  for (int i = 0; i < statements; i++)
+    {
+      struct parser_checkpoint checkpoint;
+      parser_checkpoint (process, &checkpoint);
+      checkpoint_parse (process, 1);
+      parser_rollback (process, &checkpoint);
+
+      parser_checkpoint (process, &checkpoint);
+      checkpoint_parse (process, 1);
+      parser_commit (process, &checkpoint);
+    }
+
+  double seconds = bench_seconds () - start;
+  if (vector_count (process->node_tree_vec) != statements)
+    bench_fail ("checkpoint", "parsed %d statements out of %d",
+                vector_count (process->node_tree_vec), statements);
+
+  bench_lex_free (process, lexer);
+  return seconds;
+}
+
+int
+main ()
+{
+  int sizes[] = { CHECKPOINT_STATEMENTS / 16, CHECKPOINT_STATEMENTS / 4,
+                  CHECKPOINT_STATEMENTS };
+  int total = sizeof (sizes) / sizeof (sizes[0]);
+  struct bench_sources sources;
+  bench_sources_create (&sources, sizes, total, checkpoint_write_source);
+
+  checkpoint_test (sources.fnames[0]);
+  checkpoint_misuse (sources.fnames[0], "popping under the checkpoint",
+                     checkpoint_misuse_pop);
+  checkpoint_misuse (sources.fnames[0], "declaring a symbol",
+                     checkpoint_misuse_symbol);
+  checkpoint_misuse (sources.fnames[0], "starting a symbol table",
+                     checkpoint_misuse_table);
+  bench_scaling ("checkpoint", "statements tried twice", checkpoint_bench,
+                 &sources, sizes, total);
+
+  bench_sources_free (&sources);
+  return 0;
+}
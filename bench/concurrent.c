@@ -0,0 +1,177 @@
+/*
+ * concurrent.c - Compiles many files at once and checks that every one of
+ * them gives the same result and diagnostics it gives on its own.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench/bench.h"
+#include "compiler.h"
+#include "helpers/pool.h"
+
+#define CONCURRENT_FILES 16
+#define CONCURRENT_LINES 10000
+
+// the first file is big enough to be split between lexers
+#define CONCURRENT_BIG_LINES 100000
+#define CONCURRENT_THREADS 8
+
+struct concurrent_file
+{
+  char *fname;
+  int res;
+  char *diagnostics;
+  size_t diagnostics_len;
+};
+
+struct concurrent_run
+{
+  struct concurrent_file *files;
+  int flags;
+  int lex_threads;
+};
+
+// every file is different, some of them have warnings and the last line of
+// every fourth one is an error
+static char *
+concurrent_write_file (int file)
+{
+  char *fname;
+  FILE *f = bench_create_source (&fname);
+  int lines = file == 0 ? CONCURRENT_BIG_LINES : CONCURRENT_LINES;
+  for (int i = 0; i < lines; i++)
+    {
+      int n = file * CONCURRENT_BIG_LINES + i;
+      switch (n % 7)
+        {
+        case 0:
+          fprintf (f, "long long v%d = (x + %d) * 2 /* c */\n", n, n);
+          break;
+        case 1:
+          fprintf (f, "int v%d = %d / %d\n", n, n, (n / 7) % 5);
+          break;
+        case 2:
+          fprintf (f, "char v%d = \"str %d\"\n", n, n);
+          break;
+        case 3:
+          fprintf (f, "long v%d = 9223372036854775807 + %d\n", n, n % 3);
+          break;
+        case 4:
+          fprintf (f, "// line %d\nint v%d = a < b && (c | %d) >= 0x%x\n", n,
+                   n, n, n);
+          break;
+        case 5:
+          fprintf (f, "double v%d = 2.5e3f / 1.5 - %d.25\n", n, n);
+          break;
+        default:
+          fprintf (f, "short v%d = 'x' + (((%d)))\n", n, n);
+          break;
+        }
+    }
+
+  if (file % 4 == 3)
+    fprintf (f, "int broken = (1 + 2))\n");
+
+  fclose (f);
+  return fname;
+}
+
+static void
+concurrent_compile (int job, void *private)
+{
+  struct concurrent_run *run = private;
+  struct concurrent_file *file = &run->files[job];
+
+  FILE *diagnostics
+      = open_memstream (&file->diagnostics, &file->diagnostics_len);
+  file->res = compile_file (file->fname, NULL, run->flags, run->lex_threads,
+                            diagnostics);
+  fclose (diagnostics);
+}
+
+static double
+concurrent_run (struct concurrent_file *files, int threads, int flags,
+                int lex_threads)
+{
+  struct concurrent_run run
+      = { .files = files, .flags = flags, .lex_threads = lex_threads };
+  double start = bench_seconds ();
+  pool_run (threads, CONCURRENT_FILES, concurrent_compile, &run);
+  return bench_seconds () - start;
+}
+
+static void
+concurrent_free (struct concurrent_file *files)
+{
+  for (int i = 0; i < CONCURRENT_FILES; i++)
+    free (files[i].diagnostics);
+}
+
+int
+main ()
+{
+  char *fnames[CONCURRENT_FILES];
+  for (int i = 0; i < CONCURRENT_FILES; i++)
+    fnames[i] = concurrent_write_file (i);
+
+  // lexer errors in files that were lexed first come before any warning of
+  // the parser, so every way of lexing is only compared with itself
+  struct
+  {
+    const char *name;
+    int flags;
+    int lex_threads;
+  } modes[] = {
+    { "lexed first", 0, 0 },
+    { "streamed", COMPILE_PROCESS_FLAG_STREAM_TOKENS, 0 },
+    { "lexer thread", COMPILE_PROCESS_FLAG_LEX_THREAD, 0 },
+    { "parallel lexers", 0, 4 },
+  };
+
+  for (size_t m = 0; m < sizeof (modes) / sizeof (modes[0]); m++)
+    {
+      struct concurrent_file serial[CONCURRENT_FILES] = { 0 };
+      struct concurrent_file files[CONCURRENT_FILES] = { 0 };
+      for (int i = 0; i < CONCURRENT_FILES; i++)
+        {
+          serial[i].fname = fnames[i];
+          files[i].fname = fnames[i];
+        }
+
+      double serial_seconds = concurrent_run (serial, 1, modes[m].flags,
+                                              modes[m].lex_threads);
+      double seconds = concurrent_run (files, CONCURRENT_THREADS,
+                                       modes[m].flags, modes[m].lex_threads);
+      printf ("concurrent: %d files, %s: %.3fs serial, %.3fs on %d "
+              "threads\n",
+              CONCURRENT_FILES, modes[m].name, serial_seconds, seconds,
+              CONCURRENT_THREADS);
+
+      for (int i = 0; i < CONCURRENT_FILES; i++)
+        {
+          if (files[i].res != serial[i].res
+              || files[i].diagnostics_len != serial[i].diagnostics_len
+              || memcmp (files[i].diagnostics, serial[i].diagnostics,
+                         serial[i].diagnostics_len)
+                     != 0)
+            {
+              bench_fail ("concurrent", "%s: `%s' differs from serial",
+                          modes[m].name, fnames[i]);
+            }
+        }
+
+      concurrent_free (serial);
+      concurrent_free (files);
+    }
+
+  for (int i = 0; i < CONCURRENT_FILES; i++)
+    {
+      remove (fnames[i]);
+      free (fnames[i]);
+    }
+
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * expressions.c - Times parsing long expressions, and folding them, at
+ * growing sizes to check that it takes about as long for every term.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include "bench/bench.h"
+#include "compiler.h"
+
+#define EXPRESSIONS_TERMS 400000
+
+// a single expression of `terms' operands, joined by operators of every
+// precedence
+static void
+expressions_write_terms (FILE *f, int terms)
+{
+  const char *ops[] = { "+", "*", "-", "<<", "|", "&&", "==", "/" };
+  fprintf (f, "int v = x0");
+  for (int i = 1; i < terms; i++)
+    fprintf (f, " %s x%d", ops[i % 8], i % 100);
+
+  fprintf (f, "\n");
+}
+
+// only numbers, so the expression is folded into one as it's parsed
+static void
+expressions_write_numbers (FILE *f, int terms)
+{
+  fprintf (f, "int v = 1");
+  for (int i = 1; i < terms; i++)
+    fprintf (f, " %s %d", i % 3 ? "+" : "*", i % 3 ? i % 10 : 1);
+
+  fprintf (f, "\n");
+}
+
+// parses the file written for `terms' and returns how long it took, the
+// lexer isn't timed
+static double
+expressions_parse (void *private, int terms)
+{
+  const char *fname = bench_sources_get (private, terms);
+  struct lex_process *lexer;
+  struct compile_process *process
+      = bench_lex ("expressions", fname, &lexer);
+  jmp_buf error_jmp;
+  process->error_jmp = &error_jmp;
+  if (setjmp (error_jmp))
+    bench_fail ("expressions", "couldn't parse `%s'", fname);
+
+  double start = bench_seconds ();
+  parse (process);
+  double seconds = bench_seconds () - start;
+
+  if (vector_count (process->node_tree_vec) != 1)
+    bench_fail ("expressions", "`%s' isn't a single statement", fname);
+
+  bench_lex_free (process, lexer);
+  return seconds;
+}
+
+int
+main ()
+{
+  int sizes[] = { EXPRESSIONS_TERMS / 16, EXPRESSIONS_TERMS / 4,
+                  EXPRESSIONS_TERMS };
+  int total = sizeof (sizes) / sizeof (sizes[0]);
+
+  struct bench_sources terms;
+  bench_sources_create (&terms, sizes, total, expressions_write_terms);
+  bench_scaling ("expressions", "terms", expressions_parse, &terms, sizes,
+                 total);
+  bench_sources_free (&terms);
+
+  struct bench_sources numbers;
+  bench_sources_create (&numbers, sizes, total, expressions_write_numbers);
+  bench_scaling ("expressions", "folded numbers", expressions_parse,
+                 &numbers, sizes, total);
+  bench_sources_free (&numbers);
+  return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * keywords.c - Checks that every keyword is found by its own name, and
+ * times looking up a mix of keywords and identifiers.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include "bench/bench.h"
+#include "compiler.h"
+
+#define KEYWORDS_LOOKUPS 10000000
+
+// words that aren't keywords, some of them share a length and first and
+// last letters with one, so they hash to its slot
+static const char *keywords_identifiers[] = {
+  "x",     "main",   "value",  "intx",    "in",       "iff",  "elsee",
+  "dot",   "union_", "gato",   "reteurn", "sizeofs",  "count", "buffer",
+  "stact", "cher",   "vaid",   "_",       "unsigneds", "dd",   "lexer",
+  "token", "process", "shirt", "floot",   "whale",    "dbl",  "extent",
+};
+
+#define KEYWORDS_IDENTIFIERS                                                  \
+  (int)(sizeof (keywords_identifiers) / sizeof (*keywords_identifiers))
+
+// fails unless every keyword is found by its name and no identifier is
+static void
+keywords_check ()
+{
+  for (int keyword = KEYWORD_NONE + 1; keyword < KEYWORD_TOTAL; keyword++)
+    {
+      const char *name = keyword_name (keyword);
+      int found = keyword_lookup (name, strlen (name));
+      if (found != keyword)
+        bench_fail ("keywords", "`%s' is keyword %d but was found as %d",
+                    name, keyword, found);
+    }
+
+  for (int i = 0; i < KEYWORDS_IDENTIFIERS; i++)
+    {
+      const char *name = keywords_identifiers[i];
+      int found = keyword_lookup (name, strlen (name));
+      if (found != KEYWORD_NONE)
+        bench_fail ("keywords", "`%s' was found as keyword `%s'", name,
+                    keyword_name (found));
+    }
+}
+
+struct keywords_words
+{
+  int total;
+  const char **names;
+  size_t *lengths;
+  int found;
+};
+
+static double
+keywords_lookup (void *private, int lookups)
+{
+  struct keywords_words *words = private;
+  int found = 0;
+  double start = bench_seconds ();
+  for (int i = 0; i < lookups; i++)
+    {
+      int word = i % words->total;
+      if (keyword_lookup (words->names[word], words->lengths[word])
+          != KEYWORD_NONE)
+        found++;
+    }
+
+  double seconds = bench_seconds () - start;
+  words->found = found;
+  return seconds;
+}
+
+int
+main ()
+{
+  keywords_check ();
+
+  // as many keywords as identifiers, one after the other
+  struct keywords_words words = { 0 };
+  int keywords = KEYWORD_TOTAL - 1;
+  words.names = malloc ((keywords + KEYWORDS_IDENTIFIERS)
+                        * sizeof (*words.names));
+  words.lengths = malloc ((keywords + KEYWORDS_IDENTIFIERS)
+                          * sizeof (*words.lengths));
+  for (int i = 0; i < keywords || i < KEYWORDS_IDENTIFIERS; i++)
+    {
+      if (i < keywords)
+        words.names[words.total++] = keyword_name (KEYWORD_NONE + 1 + i);
+      if (i < KEYWORDS_IDENTIFIERS)
+        words.names[words.total++] = keywords_identifiers[i];
+    }
+  for (int i = 0; i < words.total; i++)
+    words.lengths[i] = strlen (words.names[i]);
+
+  double seconds = bench_best (keywords_lookup, &words, KEYWORDS_LOOKUPS);
+  printf ("keywords: %d lookups, %d of them keywords: %.3fs, %.1fns each\n",
+          KEYWORDS_LOOKUPS, words.found, seconds,
+          seconds / KEYWORDS_LOOKUPS * 1e9);
+
+  free (words.names);
+  free (words.lengths);
+  return 0;
+}
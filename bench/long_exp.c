@@ -0,0 +1,101 @@
+/*
+ * long_exp.c - Parses expressions with a million terms, and parentheses
+ * nested a million deep, within a fixed amount of memory.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include <stdlib.h>
+
+#include "bench/bench.h"
+#include "compiler.h"
+
+#define LONG_EXP_TERMS 1000000
+#define LONG_EXP_DEPTH 1000000
+
+// nothing here should need more than this, in kilobytes
+#define LONG_EXP_MAX_RSS (256 * 1024)
+
+static char *
+long_exp_write_terms (_Bool numbers)
+{
+  char *fname;
+  FILE *f = bench_create_source (&fname);
+  const char *ops = "+-*|&^";
+  fprintf (f, "int v = 1");
+  for (int i = 1; i < LONG_EXP_TERMS; i++)
+    {
+      // only numbers are folded as they're parsed, these stay a million
+      // terms long
+      if (numbers)
+        fprintf (f, " + %d", i % 10);
+      else
+        fprintf (f, " %c x%d", ops[i % 6], i % 100);
+    }
+
+  fprintf (f, "\n");
+  fclose (f);
+  return fname;
+}
+
+static char *
+long_exp_write_nested ()
+{
+  char *fname;
+  FILE *f = bench_create_source (&fname);
+  fprintf (f, "int v = ");
+  for (int i = 0; i < LONG_EXP_DEPTH; i++)
+    fprintf (f, "(x%d + ", i % 100);
+
+  fprintf (f, "1");
+  for (int i = 0; i < LONG_EXP_DEPTH; i++)
+    fprintf (f, ")");
+
+  fprintf (f, "\n");
+  fclose (f);
+  return fname;
+}
+
+static void
+long_exp_compile (const char *name, char *fname, int flags)
+{
+  double start = bench_seconds ();
+  int res = compile_file (fname, NULL, flags, 0, stderr);
+  double seconds = bench_seconds () - start;
+  long rss = bench_peak_rss ();
+  printf ("long_exp: %s%s: %.3fs, peak rss %ldkb\n", name,
+          flags & COMPILE_PROCESS_FLAG_STREAM_TOKENS ? " (streamed)" : "",
+          seconds, rss);
+
+  if (res != COMPILER_FILE_COMPILED_OK)
+    bench_fail ("long_exp", "%s didn't compile", name);
+
+  if (rss > LONG_EXP_MAX_RSS)
+    bench_fail ("long_exp", "%s took more than %dkb", name,
+                LONG_EXP_MAX_RSS);
+}
+
+int
+main ()
+{
+  struct
+  {
+    const char *name;
+    char *fname;
+  } inputs[] = {
+    { "1M terms", long_exp_write_terms (0) },
+    { "1M numbers", long_exp_write_terms (1) },
+    { "1M parentheses", long_exp_write_nested () },
+  };
+
+  for (size_t i = 0; i < sizeof (inputs) / sizeof (inputs[0]); i++)
+    {
+      long_exp_compile (inputs[i].name, inputs[i].fname, 0);
+      long_exp_compile (inputs[i].name, inputs[i].fname,
+                        COMPILE_PROCESS_FLAG_STREAM_TOKENS);
+      remove (inputs[i].fname);
+      free (inputs[i].fname);
+    }
+
+  return 0;
+}
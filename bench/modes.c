@@ -0,0 +1,111 @@
+/*
+ * modes.c - Compiles inputs that once broke in some ways of lexing but not
+ * in others, every way there is, and checks they all agree.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench/bench.h"
+#include "compiler.h"
+
+// well past how many tokens a streamed token stream keeps behind the parser
+#define MODES_STARS 3000
+
+struct modes_result
+{
+  int res;
+  char *diagnostics;
+  size_t diagnostics_len;
+};
+
+// a datatype followed by more stars than the stream keeps, its tokens used
+// to be read once the stars were over
+static void
+modes_write_stars (FILE *f)
+{
+  const char *types[] = { "int", "long long", "unsigned long", "double" };
+  for (size_t i = 0; i < sizeof (types) / sizeof (types[0]); i++)
+    {
+      fprintf (f, "%s ", types[i]);
+      for (int j = 0; j < MODES_STARS; j++)
+        fputc ('*', f);
+
+      fprintf (f, " v%zu = %zu\n", i, i);
+    }
+}
+
+static struct modes_result
+modes_compile (const char *fname, int flags, int lex_threads)
+{
+  struct modes_result result = { 0 };
+  FILE *diagnostics
+      = open_memstream (&result.diagnostics, &result.diagnostics_len);
+  result.res = compile_file (fname, NULL, flags, lex_threads, diagnostics);
+  fclose (diagnostics);
+  return result;
+}
+
+int
+main ()
+{
+  struct
+  {
+    const char *name;
+    void (*write) (FILE *f);
+  } inputs[] = {
+    { "stars", modes_write_stars },
+  };
+
+  struct
+  {
+    const char *name;
+    int flags;
+    int lex_threads;
+  } modes[] = {
+    { "lexed first", 0, 0 },
+    { "streamed", COMPILE_PROCESS_FLAG_STREAM_TOKENS, 0 },
+    { "lexer thread", COMPILE_PROCESS_FLAG_LEX_THREAD, 0 },
+    { "parallel lexers", 0, 4 },
+  };
+
+  for (size_t i = 0; i < sizeof (inputs) / sizeof (inputs[0]); i++)
+    {
+      char *fname;
+      FILE *f = bench_create_source (&fname);
+      inputs[i].write (f);
+      fclose (f);
+
+      struct modes_result first = modes_compile (fname, modes[0].flags,
+                                                 modes[0].lex_threads);
+      if (first.res != COMPILER_FILE_COMPILED_OK)
+        bench_fail ("modes", "%s: didn't compile when %s", inputs[i].name,
+                    modes[0].name);
+
+      for (size_t m = 1; m < sizeof (modes) / sizeof (modes[0]); m++)
+        {
+          struct modes_result result = modes_compile (
+              fname, modes[m].flags, modes[m].lex_threads);
+          if (result.res != first.res
+              || result.diagnostics_len != first.diagnostics_len
+              || memcmp (result.diagnostics, first.diagnostics,
+                         first.diagnostics_len)
+                     != 0)
+            {
+              bench_fail ("modes", "%s: %s isn't the same as %s",
+                          inputs[i].name, modes[m].name, modes[0].name);
+            }
+
+          free (result.diagnostics);
+        }
+
+      printf ("modes: %s: the same every way\n", inputs[i].name);
+      free (first.diagnostics);
+      remove (fname);
+      free (fname);
+    }
+
+  return 0;
+}
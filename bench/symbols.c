@@ -0,0 +1,106 @@
+/*
+ * symbols.c - Registers and looks up a million symbols, and enters and
+ * leaves a lot of small blocks after a big one.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include <stdlib.h>
+
+#include "bench/bench.h"
+#include "compiler.h"
+
+#define SYMBOLS_TOTAL 1000000
+#define SYMBOLS_BLOCKS 100000
+
+static char names[SYMBOLS_TOTAL][16];
+
+// registers `total' symbols in a table of their own and looks every one of
+// them up, returns how long it took
+static double
+symbols_run (void *private, int total)
+{
+  struct compile_process *process = private;
+  double start = bench_seconds ();
+  symres_new_table (process);
+  for (int i = 0; i < total; i++)
+    {
+      if (!symres_register_symbol (process, names[i], SYMBOL_TYPE_UNKNOWN,
+                                   names[i]))
+        bench_fail ("symbols", "couldn't register `%s'", names[i]);
+    }
+
+  for (int i = 0; i < total; i++)
+    {
+      struct symbol *sym = symres_get_symbol (process, names[i]);
+      if (!sym || sym->data != names[i])
+        bench_fail ("symbols", "`%s' wasn't found", names[i]);
+    }
+
+  if (symres_register_symbol (process, names[0], SYMBOL_TYPE_UNKNOWN, NULL))
+    bench_fail ("symbols", "`%s' was registered twice", names[0]);
+
+  symres_end_table (process);
+  if (total && symres_get_symbol (process, names[0]))
+    bench_fail ("symbols", "`%s' outlived its table", names[0]);
+
+  return bench_seconds () - start;
+}
+
+// enters and leaves a block with a couple of symbols in it, over and over,
+// right after a block with `before' symbols
+static double
+symbols_blocks (void *private, int before)
+{
+  struct compile_process *process = private;
+  symres_new_table (process);
+  for (int i = 0; i < before; i++)
+    symres_register_symbol (process, names[i], SYMBOL_TYPE_UNKNOWN, NULL);
+
+  symres_end_table (process);
+
+  double start = bench_seconds ();
+  for (int i = 0; i < SYMBOLS_BLOCKS; i++)
+    {
+      symres_new_table (process);
+      symres_register_symbol (process, names[i], SYMBOL_TYPE_UNKNOWN, NULL);
+      symres_register_symbol (process, names[i + 1], SYMBOL_TYPE_UNKNOWN,
+                              NULL);
+      symres_end_table (process);
+    }
+
+  return bench_seconds () - start;
+}
+
+int
+main ()
+{
+  char *fname;
+  fclose (bench_create_source (&fname));
+  struct compile_process *process
+      = compile_process_create (fname, NULL, 0, stderr);
+  if (!process)
+    bench_fail ("symbols", "couldn't open `%s'", fname);
+
+  for (int i = 0; i < SYMBOLS_TOTAL; i++)
+    sprintf (names[i], "sym%d", i);
+
+  int sizes[] = { SYMBOLS_TOTAL / 16, SYMBOLS_TOTAL / 4, SYMBOLS_TOTAL };
+  bench_scaling ("symbols", "symbols", symbols_run, process, sizes,
+                 sizeof (sizes) / sizeof (sizes[0]));
+
+  // the table of the big block is the one the small ones get
+  double small_blocks = bench_best (symbols_blocks, process, 0);
+  double blocks = bench_best (symbols_blocks, process, SYMBOLS_TOTAL);
+  printf ("symbols: %d small blocks: %.3fs, after a big one: %.3fs\n",
+          SYMBOLS_BLOCKS, small_blocks, blocks);
+
+  compile_process_free (process);
+  remove (fname);
+  free (fname);
+
+  if (blocks > small_blocks * BENCH_MAX_SLOWDOWN)
+    bench_fail ("symbols", "small blocks are slower after a big one");
+
+  return 0;
+}
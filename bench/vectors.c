@@ -0,0 +1,117 @@
+/*
+ * vectors.c - Times pushing, peeking and popping ten million elements.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include <stdlib.h>
+
+#include "bench/bench.h"
+#include "helpers/vector.h"
+
+#define VECTORS_TOTAL 10000000
+#define VECTORS_CHUNK 1000
+
+// pushes [0, total) one at a time and returns how long it took
+static double
+vectors_push (struct vector *vector, int total)
+{
+  double start = bench_seconds ();
+  for (int i = 0; i < total; i++)
+    vector_push (vector, &i);
+
+  return bench_seconds () - start;
+}
+
+// pushes into a vector that starts out empty, so it has to grow all the
+// way up
+static double
+vectors_grow (void *private, int total)
+{
+  struct vector *vector = private;
+  vector_clear (vector);
+  vector_shrink_to_fit (vector);
+  return vectors_push (vector, total);
+}
+
+static double
+vectors_push_multiple (struct vector *vector, int total)
+{
+  int chunk[VECTORS_CHUNK];
+  double start = bench_seconds ();
+  for (int i = 0; i < total; i += VECTORS_CHUNK)
+    {
+      for (int j = 0; j < VECTORS_CHUNK; j++)
+        chunk[j] = i + j;
+
+      vector_push_multiple (vector, chunk, VECTORS_CHUNK);
+    }
+
+  return bench_seconds () - start;
+}
+
+// peeks at every element, they have to be [0, total)
+static double
+vectors_peek (struct vector *vector, int total)
+{
+  double start = bench_seconds ();
+  vector_set_peek_pointer (vector, 0);
+  int *elem;
+  int i = 0;
+  while ((elem = vector_peek (vector)))
+    {
+      if (*elem != i++)
+        bench_fail ("vectors", "element %d is %d", i - 1, *elem);
+    }
+
+  if (i != total)
+    bench_fail ("vectors", "peeked %d elements out of %d", i, total);
+
+  return bench_seconds () - start;
+}
+
+static double
+vectors_pop (struct vector *vector)
+{
+  double start = bench_seconds ();
+  while (!vector_empty (vector))
+    vector_pop (vector);
+
+  return bench_seconds () - start;
+}
+
+int
+main ()
+{
+  struct vector *vector = vector_create (sizeof (int));
+
+  // nothing was saved, so there shouldn't be anywhere to save it
+  if (vector->saves)
+    bench_fail ("vectors", "saves were allocated up front");
+
+  int sizes[] = { VECTORS_TOTAL / 16, VECTORS_TOTAL / 4, VECTORS_TOTAL };
+  bench_scaling ("vectors", "pushes", vectors_grow, vector, sizes,
+                 sizeof (sizes) / sizeof (sizes[0]));
+
+  double peek = vectors_peek (vector, VECTORS_TOTAL);
+  double pop = vectors_pop (vector);
+  printf ("vectors: %d elements, peek %.3fs, pop %.3fs\n", VECTORS_TOTAL,
+          peek, pop);
+
+  double multiple = vectors_push_multiple (vector, VECTORS_TOTAL);
+  vectors_peek (vector, VECTORS_TOTAL);
+
+  double start = bench_seconds ();
+  vector_truncate (vector, 0);
+  double truncate = bench_seconds () - start;
+
+  vector_shrink_to_fit (vector);
+  vector_reserve (vector, VECTORS_TOTAL);
+  double reserved = vectors_push (vector, VECTORS_TOTAL);
+  printf ("vectors: push %d at a time %.3fs, truncate %.6fs, push after "
+          "reserving %.3fs\n",
+          VECTORS_CHUNK, multiple, truncate, reserved);
+
+  vector_free (vector);
+  return 0;
+}
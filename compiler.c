@@ -15,16 +15,39 @@ struct lex_process_functions compiler_lex_functions
         .peek_char = compile_process_peek_char,
         .push_char = compile_process_push_char };
 
+struct lex_process_functions compiler_mem_lex_functions
+    = { .next_char = compile_process_mem_next_char,
+        .peek_char = compile_process_mem_peek_char,
+        .push_char = compile_process_mem_push_char,
+        .input = compile_process_mem_input,
+        .skip_chars = compile_process_mem_skip_chars };
+
 void
 compiler_error (struct compile_process *compiler, const char *msg, ...)
 {
   va_list args;
   va_start (args, msg);
-  vfprintf (stderr, msg, args);
+  vfprintf (compiler->diagnostics, msg, args);
   va_end (args);
 
-  fprintf (stderr, " on line %d, col %d in file %s\n", compiler->pos.line,
-           compiler->pos.col, compiler->pos.fname);
+  struct pos pos = compile_process_pos (compiler, compiler->offset);
+  fprintf (compiler->diagnostics, " on line %d, col %d in file %s\n",
+           pos.line, pos.col, pos.fname);
+
+  if (compiler->error_jmp)
+    longjmp (*compiler->error_jmp, 1);
+
+  exit (-1);
+}
+
+void
+compiler_fail (struct compile_process *compiler, const char *diagnostics,
+               size_t len)
+{
+  fwrite (diagnostics, 1, len, compiler->diagnostics);
+  if (compiler->error_jmp)
+    longjmp (*compiler->error_jmp, 1);
+
   exit (-1);
 }
 
@@ -33,36 +56,40 @@ compiler_warning (struct compile_process *compiler, const char *msg, ...)
 {
   va_list args;
   va_start (args, msg);
-  vfprintf (stderr, msg, args);
+  vfprintf (compiler->diagnostics, msg, args);
   va_end (args);
 
-  fprintf (stderr, " on line %d, col %d in file %s\n", compiler->pos.line,
-           compiler->pos.col, compiler->pos.fname);
+  struct pos pos = compile_process_pos (compiler, compiler->offset);
+  fprintf (compiler->diagnostics, " on line %d, col %d in file %s\n",
+           pos.line, pos.col, pos.fname);
 }
 
-int
-compile_file (const char *fname, const char *out_fname, int flags)
+// lexes and parses `process', errors jump out of here
+static int
+compiler_run (struct compile_process *process, struct lex_process *lex_process,
+              struct lex_thread *lex_thread)
 {
-  struct compile_process *process
-      = compile_process_create (fname, out_fname, flags);
-  if (!process)
-    return COMPILER_FAILED_WITH_ERRORS;
-
-  // Lexical analysis
-  struct lex_process *lex_process
-      = lex_process_create (process, &compiler_lex_functions, NULL);
-  if (!lex_process)
+  process->tokens = lex_process->tokens;
+  if (lex_thread)
     {
-      return COMPILER_FAILED_WITH_ERRORS;
+      // the tokens come from the lexer's thread, we only need the input
+      lex_begin (lex_process);
+      process->tokens->lex_thread = lex_thread;
     }
-
-  if (lex (lex_process) != LEXICAL_ANALYSIS_ALL_OK)
+  else if (process->flags
+           & (COMPILE_PROCESS_FLAG_STREAM_TOKENS
+              | COMPILE_PROCESS_FLAG_LEX_THREAD))
+    {
+      // the parser pulls tokens out of the lexer as it goes
+      lex_begin (lex_process);
+      process->tokens->lexer = lex_process;
+    }
+  else if (lex_parallel (lex_process, process->lex_threads)
+           != LEXICAL_ANALYSIS_ALL_OK)
     {
       return COMPILER_FAILED_WITH_ERRORS;
     }
 
-  process->token_vec = lex_process->token_vec;
-
   // Parsing
   if (parse (process) != PARSE_ALL_OK)
     {
@@ -73,3 +100,59 @@ compile_file (const char *fname, const char *out_fname, int flags)
 
   return COMPILER_FILE_COMPILED_OK;
 }
+
+int
+compile_file (const char *fname, const char *out_fname, int flags,
+              int lex_threads, FILE *diagnostics)
+{
+  if (!diagnostics)
+    diagnostics = stderr;
+
+  struct compile_process *process
+      = compile_process_create (fname, out_fname, flags, diagnostics);
+  if (!process)
+    {
+      return COMPILER_FAILED_WITH_ERRORS;
+    }
+
+  process->lex_threads = lex_threads;
+
+  // Lexical analysis, straight from memory unless the input couldn't be
+  // loaded (i.e. it's a pipe)
+  struct lex_process_functions *lex_functions
+      = process->cfile.data ? &compiler_mem_lex_functions
+                            : &compiler_lex_functions;
+  struct lex_process *lex_process
+      = lex_process_create (process, lex_functions, NULL);
+  if (!lex_process)
+    {
+      compile_process_free (process);
+      return COMPILER_FAILED_WITH_ERRORS;
+    }
+
+  // nothing after the lexer needs newlines or comments
+  lex_process->flags |= LEX_PROCESS_FLAG_DROP_TRIVIA;
+
+  // inputs that aren't in memory are streamed instead
+  struct lex_thread *lex_thread = NULL;
+  if (flags & COMPILE_PROCESS_FLAG_LEX_THREAD)
+    lex_thread = lex_thread_start (process, lex_process);
+
+  // errors give up on this file only, other files might be compiling on
+  // other threads
+  jmp_buf error_jmp;
+  process->diagnostics = diagnostics;
+  process->error_jmp = &error_jmp;
+
+  int res = COMPILER_FAILED_WITH_ERRORS;
+  if (!setjmp (error_jmp))
+    res = compiler_run (process, lex_process, lex_thread);
+
+  if (lex_thread)
+    lex_thread_free (lex_thread);
+
+  // everything the compilation made goes away with it
+  lex_process_free (lex_process);
+  compile_process_free (process);
+  return res;
+}
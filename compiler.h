@@ -10,13 +10,24 @@
 
 #include <assert.h>
 
+#include <pthread.h>
+#include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "helpers/arena.h"
+#include "helpers/hashmap.h"
+#include "helpers/intern.h"
+#include "helpers/ring.h"
 #include "helpers/vector.h"
 
-#define S_EQ(str, str2) (str && str2 && (strcmp (str, str2) == 0))
+#define S_EQ(str, str2)                                                       \
+  (str && str2 && ((str) == (str2) || strcmp (str, str2) == 0))
+
+// strings coming from the intern table are unique, comparing their address is
+// enough
+#define S_EQ_INTERNED(str, str2) ((str) && (str) == (str2))
 
 #define NUMERIC_CASE                                                          \
   case '0':                                                                   \
@@ -59,9 +70,10 @@
   case ')':                                                                   \
   case ']'
 
+// a decoded source position, everything else just keeps an offset into the
+// input and works this out when it's about to be printed
 struct pos
 {
-  // store the position we are at
   int line;
   int col;
   const char *fname;
@@ -79,19 +91,134 @@ enum
   TOKEN_TYPE_NEWLINE
 };
 
+enum
+{
+  KEYWORD_NONE,
+  KEYWORD_UNSIGNED,
+  KEYWORD_SIGNED,
+  KEYWORD_CHAR,
+  KEYWORD_SHORT,
+  KEYWORD_INT,
+  KEYWORD_LONG,
+  KEYWORD_FLOAT,
+  KEYWORD_DOUBLE,
+  KEYWORD_VOID,
+  KEYWORD_STRUCT,
+  KEYWORD_UNION,
+  KEYWORD_STATIC,
+  KEYWORD_IGNORE_TYPECHECK,
+  KEYWORD_RETURN,
+  KEYWORD_INCLUDE,
+  KEYWORD_SIZEOF,
+  KEYWORD_IF,
+  KEYWORD_ELSE,
+  KEYWORD_WHILE,
+  KEYWORD_FOR,
+  KEYWORD_DO,
+  KEYWORD_BREAK,
+  KEYWORD_CONTINUE,
+  KEYWORD_SWITCH,
+  KEYWORD_CASE,
+  KEYWORD_DEFAULT,
+  KEYWORD_GOTO,
+  KEYWORD_TYPEDEF,
+  KEYWORD_CONST,
+  KEYWORD_EXTERN,
+  KEYWORD_RESTRICT,
+  KEYWORD_TOTAL
+};
+
+enum
+{
+  KEYWORD_FLAG_DATATYPE = 0b00000001,
+  KEYWORD_FLAG_PRIMITIVE = 0b00000010,
+  KEYWORD_FLAG_VARIABLE_MODIFIER = 0b00000100
+};
+
+enum
+{
+  OPERATOR_NONE,
+  OPERATOR_INCREMENT,
+  OPERATOR_DECREMENT,
+  OPERATOR_CALL,
+  OPERATOR_SUBSCRIPT,
+  OPERATOR_LEFT_PARENTHESES,
+  OPERATOR_LEFT_BRACKET,
+  OPERATOR_DOT,
+  OPERATOR_ARROW,
+  OPERATOR_MULTIPLY,
+  OPERATOR_DIVIDE,
+  OPERATOR_MODULO,
+  OPERATOR_PLUS,
+  OPERATOR_MINUS,
+  OPERATOR_LEFT_SHIFT,
+  OPERATOR_RIGHT_SHIFT,
+  OPERATOR_LESS,
+  OPERATOR_LESS_EQUAL,
+  OPERATOR_GREATER,
+  OPERATOR_GREATER_EQUAL,
+  OPERATOR_EQUAL,
+  OPERATOR_NOT_EQUAL,
+  OPERATOR_BITWISE_AND,
+  OPERATOR_BITWISE_XOR,
+  OPERATOR_BITWISE_OR,
+  OPERATOR_LOGICAL_AND,
+  OPERATOR_LOGICAL_OR,
+  OPERATOR_QUESTION,
+  OPERATOR_COLON,
+  OPERATOR_ASSIGN,
+  OPERATOR_ADD_ASSIGN,
+  OPERATOR_SUB_ASSIGN,
+  OPERATOR_MUL_ASSIGN,
+  OPERATOR_DIV_ASSIGN,
+  OPERATOR_MOD_ASSIGN,
+  OPERATOR_LEFT_SHIFT_ASSIGN,
+  OPERATOR_RIGHT_SHIFT_ASSIGN,
+  OPERATOR_AND_ASSIGN,
+  OPERATOR_XOR_ASSIGN,
+  OPERATOR_OR_ASSIGN,
+  OPERATOR_COMMA,
+  OPERATOR_LOGICAL_NOT,
+  OPERATOR_BITWISE_NOT,
+  OPERATOR_ELLIPSIS,
+  OPERATOR_TOTAL
+};
+
 enum
 {
   NUMBER_TYPE_NORMAL, // integers
   NUMBER_TYPE_LONG,
   NUMBER_TYPE_FLOAT,
-  NUMBER_TYPE_DOUBLE
+  NUMBER_TYPE_DOUBLE,
+  NUMBER_TYPE_LONG_LONG,
+  NUMBER_TYPE_LONG_DOUBLE
 };
 
-struct token
+enum
+{
+  NUMBER_FLAG_UNSIGNED = 0b00000001
+};
+
+struct token_number
 {
   int type;
   int flags;
-  struct pos pos;
+};
+
+// a token as the lexer builds it, before it's packed into a token stream
+struct token
+{
+  int type;
+
+  // where the token is in the input, in characters
+  unsigned int offset;
+  unsigned int len;
+
+  // KEYWORD_NONE unless this is a keyword token
+  int keyword;
+
+  // OPERATOR_NONE unless this is an operator token
+  int op;
 
   union
   {
@@ -100,54 +227,226 @@ struct token
     unsigned int inum;
     unsigned long lnum;
     unsigned long long llnum;
+    double dval;
     void *any;
   };
 
-  struct token_number
-  {
-    int type;
-  } num;
+  struct token_number num;
+
+  // identifiers, strings and comments can be left in the input instead of
+  // being copied, `sval' is NULL then and their text is `text_len'
+  // characters long, right after the opening delimiters
+  unsigned int text_len;
 
   // is there a whitespace between the token and next token
   // i.e. * a for operator * whitespace would be set for token "a"
   _Bool whitespace;
+};
+
+// layout of the `kind' byte of a token in a token stream
+enum
+{
+  TOKEN_KIND_TYPE_MASK = 0b00000111,
+  TOKEN_KIND_WHITESPACE = 0b00001000,
+
+  // plain and long integers that fit in 32 bits keep their type here, any
+  // other number goes to `numbers'
+  TOKEN_KIND_NUMBER_TYPE_MASK = 0b00110000,
+  TOKEN_KIND_BIG_NUMBER = 0b01000000,
+
+  // the text of an identifier, string or comment was copied to the intern
+  // table, otherwise it's still in the input
+  TOKEN_KIND_COPIED = 0b10000000
+};
+
+#define TOKEN_KIND_NUMBER_TYPE_SHIFT 4
+
+// a number that doesn't fit in a token stream's `value'
+struct token_stream_number
+{
+  union
+  {
+    unsigned long long llnum;
+    double dval;
+  };
+
+  struct token_number num;
+};
+
+// a token taken out of a token stream, to be put into another one that
+// doesn't share its strings or numbers (see token_stream_take)
+struct token_stream_entry
+{
+  unsigned char kind;
+  unsigned int offset;
+  unsigned int len;
+  unsigned int value;
+
+  // the copied text (TOKEN_KIND_COPIED) or the number that didn't fit in
+  // `value' (TOKEN_KIND_BIG_NUMBER)
+  const char *sval;
+  size_t sval_len;
+  struct token_stream_number number;
+};
 
-  // if it's between brackets, points to the opening bracket
-  // i.e. (5+10+20) tokens 5, 10 and 20, will point to "("
-  const char *between_brackets;
+// the side of a bracket that wasn't matched yet (see
+// LEX_PROCESS_FLAG_NO_BRACKETS)
+#define TOKEN_BRACKETS_UNMATCHED ((unsigned int)-1)
+
+// a top level pair of brackets, i.e. the outer ones in ((5+10)+20)
+struct token_brackets
+{
+  // offsets of the `(' and its matching `)'
+  unsigned int open;
+  unsigned int close;
+};
+
+/**
+ * Tokens, stored as a structure of arrays. A token is just an index into
+ * them, -1 being no token at all. The arrays are a ring, token `i' lives in
+ * slot `i & mask'. Tokens take 13 bytes each:
+ *
+ * kind:   type, whitespace and number flags (see TOKEN_KIND_*)
+ * offset: where the token starts in the input
+ * len:    how many characters it takes
+ * value:  the keyword, operator or symbol; for identifiers, strings and
+ *         comments the length of their text in `source', or the id of an
+ *         interned copy (see TOKEN_KIND_COPIED); the value of a number, or
+ *         an index into `numbers' if it doesn't fit in 32 bits or isn't a
+ *         plain integer
+ *
+ * When the stream is fed by a lexer as the parser goes (see `lexer' and
+ * `lex_thread'), tokens well behind the parser are recycled, only those
+ * after `base' are kept.
+ */
+struct token_stream
+{
+  unsigned char *kind;
+  unsigned int *offset;
+  unsigned int *len;
+  unsigned int *value;
+
+  // tokens in [base, count) are available
+  int base;
+  int count;
+
+  // always a power of two
+  int capacity;
+  int mask;
+
+  // next token to be read by the parser
+  int cursor;
+
+  // saved cursors (int), tokens after the first one aren't recycled
+  struct vector *saves;
+
+  // reads more tokens when the parser needs them, NULL if the stream was
+  // read in one go or the input is over
+  struct lex_process *lexer;
+
+  // same, but for a lexer running on another thread
+  struct lex_thread *lex_thread;
+
+  // numbers that don't fit in `value' (struct token_stream_number). The
+  // first `numbers_base' belonged to recycled tokens and are gone, `value'
+  // still counts them
+  struct vector *numbers;
+  unsigned int numbers_base;
+
+  // top level brackets, sorted (struct token_brackets). The ones before
+  // `brackets_base' belong to recycled tokens
+  struct vector *brackets;
+  int brackets_base;
+
+  // the input the tokens were read from, NULL if it wasn't in memory
+  const char *source;
+  struct intern *strings;
+
+  // the lexer left out newlines, comments and line continuations, every
+  // token in here means something to the parser
+  _Bool significant_only;
 };
 
 struct lex_process;
 typedef char (*LEX_PROCESS_NEXT_CHAR) (struct lex_process *process);
 typedef char (*LEX_PROCESS_PEEK_CHAR) (struct lex_process *process);
 typedef void (*LEX_PROCESS_PUSH_CHAR) (struct lex_process *process, char c);
+typedef const char *(*LEX_PROCESS_INPUT) (struct lex_process *process,
+                                          size_t *left);
+typedef void (*LEX_PROCESS_SKIP_CHARS) (struct lex_process *process,
+                                        size_t n);
 
 struct lex_process_functions
 {
   LEX_PROCESS_NEXT_CHAR next_char;
   LEX_PROCESS_PEEK_CHAR peek_char;
   LEX_PROCESS_PUSH_CHAR push_char;
+
+  // optional, only for inputs that are resident in memory. `input' gives the
+  // characters not read yet so the lexer can scan them in bulk, and
+  // `skip_chars' consumes `n' of them at once. Tokens keep pointing into the
+  // input, so characters must stay where they are once read
+  LEX_PROCESS_INPUT input;
+  LEX_PROCESS_SKIP_CHARS skip_chars;
 };
 
-struct lex_process
+enum
 {
+  // newlines, comments and line continuations are read but not pushed into
+  // the token stream, the parser doesn't care about them
+  LEX_PROCESS_FLAG_DROP_TRIVIA = 0b00000001,
+
+  // brackets aren't matched, for lexers that start halfway through the
+  // input. Every `(' and `)' is pushed into the brackets of the stream on
+  // its own, the other side left unmatched, for whoever takes the tokens to
+  // match them (see lex_follow_brackets)
+  LEX_PROCESS_FLAG_NO_BRACKETS = 0b00000010
+};
 
-  struct pos pos;
-  struct vector *token_vec;
+struct lex_process
+{
+  int flags;
+  struct token_stream *tokens;
   struct compile_process *compiler;
 
+  // characters read so far, and where the token being read starts
+  unsigned int offset;
+  unsigned int token_start;
+
+  // trivia was dropped since the last token, so the next one doesn't come
+  // right after it even if there's no whitespace left in between
+  _Bool after_trivia;
+
   /*
    * number of brackets, in ((60)) for example, it'd be 2
    */
   int current_expression_count;
-  struct buffer *parentheses_buffer;
+  unsigned int expression_start;
   struct lex_process_functions *function;
 
+  // scratch space for the text of the token being read, it's reused for
+  // every token. Strings that outlive the token go to the intern table
+  struct buffer *token_buffer;
+
+  // the token just read, until it's pushed into `tokens'
+  struct token token;
+
   // point to private data that the lexer does not understand, but the person
   // using the lexer does.
   void *private;
 };
 
+enum
+{
+  // tokens are read as the parser needs them, instead of reading the whole
+  // file before parsing
+  COMPILE_PROCESS_FLAG_STREAM_TOKENS = 0b00000001,
+
+  // tokens are read by a thread of its own while the parser takes them.
+  // Only for inputs in memory, the rest are streamed
+  COMPILE_PROCESS_FLAG_LEX_THREAD = 0b00000010
+};
+
 // this will be used as return codes, if there was an error or if compiling
 // went ok
 enum
@@ -166,15 +465,37 @@ struct scope
 {
   int flags;
 
+  // how many scopes there are above this one
+  int depth;
+
   // a vector of void ptrs
   struct vector *entities;
 
   // total number of bytes of this scope (aligned to 16 bytes)
   size_t size;
 
+  // where the names bound in this scope start in `bindings' of the compile
+  // process
+  int first_binding;
+
+  // the scope this one is in. Once finished, the next one to be reused
   struct scope *parent;
 };
 
+// a name visible from the current scope, see scope_bind
+struct scope_binding
+{
+  const char *name;
+  void *entity;
+
+  // depth of the scope it was bound in
+  int depth;
+
+  // the binding of the same name this one hides, NULL if none. Once the
+  // binding is gone, the next one that can be reused
+  struct scope_binding *shadowed;
+};
+
 enum
 {
   SYMBOL_TYPE_NODE,
@@ -186,7 +507,24 @@ struct symbol
 {
   const char *name;
   int type;
-  void *data;
+
+  union
+  {
+    // for SYMBOL_TYPE_NODE
+    int node;
+    void *data;
+  };
+};
+
+// an operator that's still waiting for its right operand, or an open
+// parentheses (OPERATOR_LEFT_PARENTHESES)
+struct parser_exp_op
+{
+  int op;
+  int precedence;
+
+  // where the operator is in the input
+  unsigned int offset;
 };
 
 struct compile_process
@@ -194,37 +532,132 @@ struct compile_process
   // this will determine how code must be compiled
   int flags;
 
-  struct pos pos;
+  // threads to lex the input with when it's in memory and lexed before
+  // parsing, 1 or less lexes it on the calling thread
+  int lex_threads;
+
+  // where we are in the input, it's what errors and warnings point at
+  unsigned int offset;
+
+  // where errors and warnings are written, stderr unless told otherwise
+  FILE *diagnostics;
+
+  // compiler_error jumps here to give up on the compilation. With nowhere to
+  // jump to, it exits
+  jmp_buf *error_jmp;
+
   struct compile_process_input_file
   {
     FILE *fp;
     const char *abs_path;
+
+    // the whole file, mapped (or read) into memory. NULL when we couldn't do
+    // it (i.e. for pipes) and we have to fall back to reading from `fp'
+    const char *data;
+    size_t size;
+    size_t offset;
+    _Bool mapped;
+
+    // offset of the first character of every line (unsigned int). Inputs in
+    // memory are only scanned for lines once a position has to be decoded,
+    // the rest record them as they are read
+    struct vector *line_starts;
+    _Bool line_starts_scanned;
   } cfile;
 
-  // vector of tokens
-  struct vector *token_vec;
+  struct token_stream *tokens;
+
+  // every string a token points to (identifiers, keywords, operators...)
+  struct intern *strings;
+
+  // nodes, datatypes, symbols... anything that lives as long as the
+  // compilation does
+  struct arena *arena;
 
+  struct ast *ast;
+
+  // every datatype used, nodes refer to them by id
+  struct datatypes *datatypes;
+
+  // nodes (int) waiting to be taken by the parser
   struct vector *node_vec;
-  struct vector *node_tree_vec; // root of the tree
+  struct vector *node_tree_vec; // root of the tree (int)
 
   FILE *out_file;
 
+  struct
+  {
+    // the last token taken, -1 if none
+    int last_token;
+
+    // to name structures and unions that don't have one
+    int random_type_index;
+
+    // operators of the expressions being parsed (struct parser_exp_op)
+    struct vector *exp_ops;
+
+    // height of the node stack when the innermost checkpoint was taken,
+    // nothing under it may be popped until the checkpoint ends
+    int node_floor;
+  } parser;
+
   struct
   {
     struct scope *root;
     struct scope *current;
+
+    // innermost binding of every name (struct scope_binding *), keyed by
+    // the interned name
+    struct hashmap *names;
+
+    // bindings of every scope from the root to the current one, innermost
+    // last (struct scope_binding *)
+    struct vector *bindings;
+
+    // finished scopes and bindings, they come from the arena
+    struct scope *free_scopes;
+    struct scope_binding *free_bindings;
   } scope;
 
   struct
   {
-    // current active symbol table
-    struct vector *table;
+    // current active symbol table, from interned names to symbols
+    struct hashmap *table;
 
-    // a vector of tables
+    // tables (struct hashmap *) under the active one
     struct vector *tables;
+
+    // tables that were ended, emptied and ready to be used again
+    struct vector *spare_tables;
   } symbols;
 };
 
+/**
+ * A lexer running on a thread of its own, feeding the parser through a
+ * ring. It works on a copy of the compile process with its own strings,
+ * input position and diagnostics, so the only things both threads touch
+ * are the (read only) input and the ring.
+ */
+struct lex_thread
+{
+  struct compile_process compiler;
+  struct compile_process *parent;
+  struct lex_process *lexer;
+
+  // tokens and brackets on their way to the parser
+  struct ring *ring;
+  pthread_t thread;
+
+  // set by the parser when it gives up, so the lexer stops early
+  atomic_bool stop;
+
+  // what the lexer printed, kept until the parser gets to the point where
+  // it failed. `failed' is only read once the ring is closed
+  char *diagnostics;
+  size_t diagnostics_len;
+  _Bool failed;
+};
+
 enum
 {
   DATATYPE_FLAG_IS_SIGNED = 0b00000001,
@@ -261,8 +694,8 @@ struct datatype
   // i.e long, int, etc;
   int type;
 
-  // i.e. long long, struct my_struct
-  struct datatype *secondary;
+  // i.e. long long, struct my_struct. Always comes from the datatypes table
+  const struct datatype *secondary;
 
   // i.e "int"
   const char *type_str;
@@ -275,11 +708,28 @@ struct datatype
 
   union
   {
-    struct node *struct_node;
-    struct node *union_node;
+    int struct_node;
+    int union_node;
   };
 };
 
+/**
+ * Every different datatype of a compilation, kept once. Interning the same
+ * datatype twice gives back the same id, so two types are the same if and
+ * only if their ids are (or the addresses datatype_get gives for them).
+ */
+struct datatypes
+{
+  // hash table, with the id + 1 of the datatype in each slot or 0 if it's
+  // empty. Its capacity is always a power of two
+  int *slots;
+  int capacity;
+
+  // datatypes by id (const struct datatype *), they live in `arena'
+  struct vector *types;
+  struct arena *arena;
+};
+
 enum
 {
   DATA_TYPE_EXPECT_PRIMITIVE,
@@ -298,16 +748,50 @@ enum
 
 void compiler_error (struct compile_process *compiler, const char *msg, ...);
 void compiler_warning (struct compile_process *compiler, const char *msg, ...);
-int compile_file (const char *fname, const char *out_fname, int flags);
+
+// gives up like compiler_error, for errors that were already written
+// somewhere else (i.e. by a lexer on another thread)
+void compiler_fail (struct compile_process *compiler, const char *diagnostics,
+                    size_t len);
+int compile_file (const char *fname, const char *out_fname, int flags,
+                  int lex_threads, FILE *diagnostics);
+
+// lexer input read straight from the file, or from memory once it's loaded
+extern struct lex_process_functions compiler_lex_functions;
+extern struct lex_process_functions compiler_mem_lex_functions;
 
 // cprocess
+// opens `fname' and `out_fname', if there's one. Files that can't be opened
+// are reported to `diagnostics'
 struct compile_process *
-compile_process_create (const char *fname, const char *out_fname, int flags);
+compile_process_create (const char *fname, const char *out_fname, int flags,
+                        FILE *diagnostics);
+void compile_process_free (struct compile_process *process);
+
+// makes `copy' a copy of `process' that can lex its input on another thread.
+// It gets its own strings and line starts, the rest is shared and has to be
+// left as it is
+void compile_process_copy (struct compile_process *copy,
+                           struct compile_process *process);
+void compile_process_free_copy (struct compile_process *copy);
 
 char compile_process_next_char (struct lex_process *lex_process);
 char compile_process_peek_char (struct lex_process *lex_process);
 void compile_process_push_char (struct lex_process *lex_process, char c);
 
+// decodes `offset' into a line and a column
+struct pos compile_process_pos (struct compile_process *process,
+                                unsigned int offset);
+
+// same as above, but reading from `cfile.data' instead of the FILE
+char compile_process_mem_next_char (struct lex_process *lex_process);
+char compile_process_mem_peek_char (struct lex_process *lex_process);
+void compile_process_mem_push_char (struct lex_process *lex_process, char c);
+const char *compile_process_mem_input (struct lex_process *lex_process,
+                                       size_t *left);
+void compile_process_mem_skip_chars (struct lex_process *lex_process,
+                                     size_t n);
+
 // parser
 enum
 {
@@ -354,37 +838,57 @@ enum
   NODE_FLAG_INSIDE_EXPRESSION = 0b00000001
 };
 
-struct node
+// the payload of an expression node
+struct node_exp
 {
-  int type;
-  int flags;
+  int left;
+  int right;
+  int op;
+};
+
+// the payload of a variable node
+struct node_var
+{
+  const char *name;
 
-  struct pos pos;
+  // id in the datatypes table
+  int type;
+  int val;
+};
 
-  struct node_binded
+// a number that doesn't fit in an ast's `data'
+struct node_number
+{
+  union
   {
-    // ptr to body node
-    struct node *owner;
+    unsigned long long llnum;
+    double dval;
+  };
 
-    // ptr to parent function
-    struct node *function;
-  } binded;
+  struct token_number num;
+};
+
+/**
+ * A node unpacked, it's what node_create takes. Nodes aren't kept like this
+ * (see `struct ast'), only the fields that matter for its type are read
+ */
+struct node
+{
+  int type;
+  int flags;
+
+  // where the node starts in the input
+  unsigned int offset;
 
   union
   {
-    struct exp
-    {
-      struct node *left;
-      struct node *right;
-      const char *op;
-    } exp;
+    struct node_exp exp;
+    struct node_var var;
 
-    struct var
+    struct
     {
-      struct datatype type;
-      const char *name;
-      struct node *val;
-    } var;
+      int exp;
+    } parenthesis;
   };
 
   union
@@ -394,46 +898,286 @@ struct node
     unsigned int inum;
     unsigned long lnum;
     unsigned long long llnum;
+    double dval;
   };
+
+  // for number nodes
+  struct token_number num;
+};
+
+// flags of a node that only the ast uses, on top of NODE_FLAG_*
+enum
+{
+  // the number is in `numbers', not in `data'
+  AST_FLAG_BIG_NUMBER = 0b10000000
+};
+
+/**
+ * The nodes of a compilation, stored as a structure of arrays. A node is just
+ * an index into them, -1 being no node at all. Every node takes 10 bytes, the
+ * kinds that need more keep it in an array of their own:
+ *
+ * type:   NODE_TYPE_*
+ * flags:  NODE_FLAG_* and AST_FLAG_*
+ * offset: where the node starts in the input
+ * data:   for identifiers and strings the id of their interned text; the
+ *         value of a plain integer that fits in 32 bits, or an index into
+ *         `numbers' for any other number; an index into `exps' or `vars'
+ *         for expressions and variables; the expression inside of
+ *         parentheses
+ */
+struct ast
+{
+  unsigned char *type;
+  unsigned char *flags;
+  unsigned int *offset;
+  unsigned int *data;
+  int count;
+  int capacity;
+
+  // payloads, by kind (struct node_exp, struct node_var and struct
+  // node_number)
+  struct vector *exps;
+  struct vector *vars;
+  struct vector *numbers;
+
+  struct intern *strings;
+};
+
+// how many nodes and payloads an ast had at some point, see ast_rewind
+struct ast_mark
+{
+  int nodes;
+  int exps;
+  int vars;
+  int numbers;
+};
+
+/**
+ * Where the parser was, so it can try a production and go back if it turns
+ * out to be the wrong one. See parser_checkpoint
+ */
+struct parser_checkpoint
+{
+  int last_token;
+
+  // heights of the node and operator stacks
+  int nodes;
+  int tree_nodes;
+  int exp_ops;
+
+  struct ast_mark ast;
+  int datatypes;
+  struct arena_mark arena;
+
+  // the floor of the checkpoint this one is in
+  int node_floor;
+
+  // the scope and symbol table it was taken in and how many names they had,
+  // to check nothing was declared before rolling back
+  struct scope *scope;
+  int bindings;
+  struct hashmap *symbols;
+  size_t symbols_count;
+  int symbol_tables;
 };
 
 int parse (struct compile_process *process);
 
+// parses one more thing at the top level, returns -1 once there's nothing
+// left. Whatever was parsed is left on the node stack
+int parse_next (struct compile_process *process);
+
+/**
+ * Takes a checkpoint, which has to be ended with either parser_rollback or
+ * parser_commit. Checkpoints nest, the last one taken is the first to end.
+ *
+ * Rolling back doesn't bring back anything that was on the node stack
+ * before the checkpoint, so whatever is tried may only pop nodes it pushed
+ * itself; node_pop asserts it doesn't. Scopes and symbols aren't rolled back
+ * either, so parser_rollback asserts they are as the checkpoint found them.
+ * What was written to the diagnostics stays written
+ */
+void parser_checkpoint (struct compile_process *process,
+                        struct parser_checkpoint *checkpoint);
+
+// puts the tokens, nodes and datatypes back the way they were
+void parser_rollback (struct compile_process *process,
+                      struct parser_checkpoint *checkpoint);
+
+// keeps what was parsed since the checkpoint
+void parser_commit (struct compile_process *process,
+                    struct parser_checkpoint *checkpoint);
+
 // lex_process
 struct lex_process *
 lex_process_create (struct compile_process *compiler,
                     struct lex_process_functions *functions, void *private);
 void lex_process_free (struct lex_process *process);
 void *lex_process_private (struct lex_process *process);
-struct vector *lex_process_tokens (struct lex_process *process);
+struct token_stream *lex_process_tokens (struct lex_process *process);
 
 // lexer
 int lex (struct lex_process *process);
 
+// same as lex, but one token at a time. lex_next returns 0 when the input is
+// over
+void lex_begin (struct lex_process *process);
+_Bool lex_next (struct lex_process *process);
+
+// matches an unmatched bracket another lexer read, as if this one had read
+// it
+void lex_follow_brackets (struct lex_process *lex_process,
+                          struct token_brackets *brackets);
+
+// lex_parallel
+// same as lex, but large inputs in memory are split in chunks and lexed on up
+// to `threads' threads. The tokens are the ones lex would have read
+int lex_parallel (struct lex_process *process, int threads);
+
+// lex_thread
+struct lex_thread *lex_thread_start (struct compile_process *process,
+                                     struct lex_process *lex_process);
+
+// moves the next token into `stream', returns 0 when the input is over. If
+// the lexer failed, its error is reported here
+_Bool lex_thread_next (struct lex_thread *lex_thread,
+                       struct token_stream *stream);
+
+// stops the lexer if it's still running
+void lex_thread_free (struct lex_thread *lex_thread);
+
 // builds token for `str'
 struct lex_process *tokens_build_for_string (struct compile_process *compiler,
                                              const char *str);
 
+// keyword
+int keyword_lookup (const char *str, size_t len);
+const char *keyword_name (int keyword);
+_Bool keyword_is_datatype (int keyword);
+_Bool keyword_is_primitive (int keyword);
+_Bool keyword_is_variable_modifier (int keyword);
+
+// number
+enum
+{
+  NUMBER_PARSE_OK,
+  NUMBER_PARSE_INVALID,
+  NUMBER_PARSE_INVALID_SUFFIX,
+  NUMBER_PARSE_TOO_LARGE
+};
+
+// length of the numeric literal at the start of `str'
+size_t number_literal_length (const char *str, size_t len);
+
+// parses a whole numeric literal into `token', returns NUMBER_PARSE_*. The
+// type of an integer is the one C gives it, not only what its suffix says
+// (i.e. 3000000000 is a long long)
+int number_parse (const char *str, size_t len, struct token *token);
+_Bool number_is_float (int type);
+
+// how wide an integer NUMBER_TYPE_* is. Kcc targets 32 bit machines, so long
+// is as wide as int
+int number_integer_bits (int type);
+
+// operator
+int operator_start (char c);
+int operator_next (int op, char c);
+const char *operator_name (int op);
+
 // token
-_Bool keyword_is_datatype (const char *str);
-_Bool token_is_keyword (struct token *token, const char *value);
-_Bool token_is_nl_or_comment_or_nl_separator (struct token *token);
-_Bool token_is_symbol (struct token *token, char c);
-_Bool token_is_operator (struct token *tok, const char *val);
-_Bool token_is_primitive_keyword (struct token *token);
+_Bool token_is_keyword (struct token_stream *stream, int token, int keyword);
+_Bool token_is_nl_or_comment_or_nl_separator (struct token_stream *stream,
+                                              int token);
+_Bool token_is_symbol (struct token_stream *stream, int token, char c);
+_Bool token_is_operator (struct token_stream *stream, int token, int op);
+_Bool token_is_primitive_keyword (struct token_stream *stream, int token);
+
+// token_stream
+struct token_stream *token_stream_create (struct intern *strings);
+void token_stream_free (struct token_stream *stream);
+int token_stream_push (struct token_stream *stream, struct token *token);
+int token_stream_last (struct token_stream *stream);
+_Bool token_stream_ensure (struct token_stream *stream, int token);
+void token_stream_save (struct token_stream *stream);
+void token_stream_restore (struct token_stream *stream);
+void token_stream_save_purge (struct token_stream *stream);
+void token_stream_push_brackets (struct token_stream *stream,
+                                 struct token_brackets *brackets);
+void token_stream_take (struct token_stream *stream, int token,
+                        struct token_stream_entry *entry);
+int token_stream_put (struct token_stream *stream,
+                      struct token_stream_entry *entry);
+
+// moves every token of `from' to the end of `stream', which doesn't share its
+// strings or numbers. Its brackets are left behind
+void token_stream_append (struct token_stream *stream,
+                          struct token_stream *from);
+
+int token_stream_type (struct token_stream *stream, int token);
+_Bool token_stream_whitespace (struct token_stream *stream, int token);
+void token_stream_set_whitespace (struct token_stream *stream, int token);
+int token_stream_keyword (struct token_stream *stream, int token);
+int token_stream_op (struct token_stream *stream, int token);
+char token_stream_cval (struct token_stream *stream, int token);
+const char *token_stream_sval (struct token_stream *stream, int token);
+const char *token_stream_text (struct token_stream *stream, int token,
+                               size_t *len);
+unsigned long long token_stream_llnum (struct token_stream *stream,
+                                       int token);
+double token_stream_dval (struct token_stream *stream, int token);
+int token_stream_number_type (struct token_stream *stream, int token);
+int token_stream_number_flags (struct token_stream *stream, int token);
+unsigned int token_stream_offset (struct token_stream *stream, int token);
+unsigned int token_stream_len (struct token_stream *stream, int token);
+const char *token_stream_between_brackets (struct token_stream *stream,
+                                           int token, size_t *len);
 
 // node
-void node_set_vector (struct vector *vec, struct vector *root_vec);
-void node_push (struct node *node);
-struct node *node_peek ();
-struct node *node_peek_or_null ();
-struct node *node_pop ();
-struct node *node_create (struct node *_node);
-void make_exp_node (struct node *left_node, struct node *right_node,
-                    const char *op);
-
-_Bool node_is_expressionable (struct node *node);
-struct node *node_peek_expressionable_or_null ();
+struct ast *ast_create (struct intern *strings);
+void ast_free (struct ast *ast);
+struct ast_mark ast_mark (struct ast *ast);
+
+// drops every node created since `mark' was taken
+void ast_rewind (struct ast *ast, struct ast_mark mark);
+
+void node_push (struct compile_process *process, int node);
+int node_peek (struct compile_process *process);
+int node_peek_or_null (struct compile_process *process);
+int node_pop (struct compile_process *process);
+int node_create (struct compile_process *process, struct node *_node);
+
+// overwrites the value of a number node, keeping its index
+void node_set_number (struct compile_process *process, int node,
+                      struct node *number);
+
+// gives back the slot of `node' if it's the last one created, which must
+// not be referenced anymore. Does nothing otherwise
+void node_discard (struct compile_process *process, int node);
+
+void make_exp_node (struct compile_process *process, int left_node,
+                    int right_node, int op);
+
+_Bool node_is_expressionable (struct compile_process *process, int node);
+int node_peek_expressionable_or_null (struct compile_process *process);
+
+int node_type (struct compile_process *process, int node);
+int node_flags (struct compile_process *process, int node);
+void node_set_flags (struct compile_process *process, int node, int flags);
+unsigned int node_offset (struct compile_process *process, int node);
+int node_parentheses_exp (struct compile_process *process, int node);
+const char *node_sval (struct compile_process *process, int node);
+unsigned long long node_llnum (struct compile_process *process, int node);
+double node_dval (struct compile_process *process, int node);
+int node_number_type (struct compile_process *process, int node);
+int node_number_flags (struct compile_process *process, int node);
+
+// payloads of expressions and variables. They move when nodes are created,
+// so don't hold on to them across a node_create
+struct node_exp *node_exp (struct compile_process *process, int node);
+struct node_var *node_var (struct compile_process *process, int node);
+const struct datatype *node_var_type (struct compile_process *process,
+                                     int node);
 
 // expressionable
 #define TOTAL_OPERATOR_GROUPS 14
@@ -447,13 +1191,86 @@ enum
 
 struct expressionable_op_precedence_group
 {
-  char *operators[MAX_OPERATORS_IN_GROUP];
+  int operators[MAX_OPERATORS_IN_GROUP];
   int associativity; // left to right or right to left
 };
 
+int expressionable_op_precedence (
+    int op, struct expressionable_op_precedence_group **group_out);
+
+/**
+ * Works out `left op right' for two number nodes the way C would at run
+ * time, after converting both to a common type, and makes `out' the
+ * resulting number. Signed integers are kept sign extended in `llnum'.
+ * Returns 0 if it can't be done (i.e. a division by zero, or an operator
+ * that isn't arithmetic, bitwise, a shift, a comparison or logical)
+ */
+_Bool expressionable_fold (struct compile_process *process, int op,
+                           struct node *left, struct node *right,
+                           struct node *out);
+
 // datatype
-_Bool datatype_is_struct_or_union_for_name (const char *name);
+_Bool datatype_is_struct_or_union_for_keyword (int keyword);
+
+struct datatypes *datatypes_create (struct arena *arena);
+void datatypes_free (struct datatypes *datatypes);
+
+// returns the id of the datatype equal to `dtype', adding it if it's new
+int datatype_intern (struct datatypes *datatypes,
+                     const struct datatype *dtype);
+const struct datatype *datatype_get (struct datatypes *datatypes, int id);
+
+// forgets every datatype with an id from `count' on
+void datatypes_truncate (struct datatypes *datatypes, int count);
 
 // scope
+struct scope *scope_create_root (struct compile_process *process);
+void scope_free_root (struct compile_process *process);
+struct scope *scope_new (struct compile_process *process, int flags);
+void scope_finish (struct compile_process *process);
+struct scope *scope_current (struct compile_process *process);
+
+void scope_iteration_start (struct scope *scope);
+void scope_iteration_end (struct scope *scope);
+void *scope_iterate_back (struct scope *scope);
+void *scope_last_entity_at_scope (struct scope *scope);
+void *scope_last_entity_stop_at (struct compile_process *process,
+                                 struct scope *stop_scope);
+void *scope_last_entity (struct compile_process *process);
+void scope_push (struct compile_process *process, void *ptr, size_t elm_size);
+
+/**
+ * Makes `name' refer to `entity' in the current scope, hiding whatever it
+ * referred to until the scope is finished. `name' must be interned
+ */
+void scope_bind (struct compile_process *process, const char *name,
+                 void *entity);
+
+/**
+ * Returns the innermost binding of `name' (interned) from the current
+ * scope, NULL if it isn't bound. Its depth tells which scope it's from
+ */
+struct scope_binding *scope_find (struct compile_process *process,
+                                  const char *name);
+
+// symres
+void symres_init (struct compile_process *process);
+void symres_free (struct compile_process *process);
+void symres_new_table (struct compile_process *process);
+void symres_end_table (struct compile_process *process);
+
+// looks `name' up in the active table only, NULL if it isn't there
+struct symbol *symres_get_symbol (struct compile_process *process,
+                                  const char *name);
+struct symbol *
+symres_get_symbol_fo_native_function (struct compile_process *process,
+                                      const char *name);
+
+// adds a symbol to the active table, NULL if the name is already taken
+struct symbol *symres_register_symbol (struct compile_process *process,
+                                       const char *sym_name, int type,
+                                       void *data);
+int sumres_node (struct symbol *sym);
+void symres_build_for_node (struct compile_process *process, int node);
 
 #endif
@@ -6,15 +6,63 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "compiler.h"
 
+// tries to get the whole input file in memory, first by mapping it and if
+// that's not possible by reading it in one go. Pipes and such are left alone,
+// those will be read through stdio.
+static void
+compile_process_load_input (struct compile_process *process)
+{
+  FILE *f = process->cfile.fp;
+  struct stat st;
+  if (fstat (fileno (f), &st) != 0 || !S_ISREG (st.st_mode))
+    return;
+
+  size_t size = st.st_size;
+  if (size == 0)
+    {
+      // nothing to map, but it's still a valid (empty) input
+      process->cfile.data = "";
+      return;
+    }
+
+  void *data = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fileno (f), 0);
+  if (data != MAP_FAILED)
+    {
+      process->cfile.data = data;
+      process->cfile.size = size;
+      process->cfile.mapped = 1;
+      return;
+    }
+
+  char *buf = malloc (size);
+  if (!buf)
+    return;
+
+  if (fread (buf, 1, size, f) != size)
+    {
+      // couldn't read it all, stdio will take it from the start
+      free (buf);
+      rewind (f);
+      return;
+    }
+
+  process->cfile.data = buf;
+  process->cfile.size = size;
+}
+
 struct compile_process *
-compile_process_create (const char *fname, const char *out_fname, int flags)
+compile_process_create (const char *fname, const char *out_fname, int flags,
+                        FILE *diagnostics)
 {
   FILE *f = fopen (fname, "r");
   if (!f)
     {
+      fprintf (diagnostics, "Couldn't open `%s'\n", fname);
       return NULL;
     }
 
@@ -25,6 +73,9 @@ compile_process_create (const char *fname, const char *out_fname, int flags)
       outf = fopen (out_fname, "w");
       if (!outf)
         {
+          fprintf (diagnostics, "Couldn't create the output file `%s'\n",
+                   out_fname);
+          fclose (f);
           return NULL;
         }
     }
@@ -32,25 +83,92 @@ compile_process_create (const char *fname, const char *out_fname, int flags)
   struct compile_process *process
       = calloc (1, sizeof (struct compile_process));
 
-  process->node_vec = vector_create (sizeof (struct node *));
-  process->node_tree_vec = vector_create (sizeof (struct node *));
+  process->node_vec = vector_create (sizeof (int));
+  process->node_tree_vec = vector_create (sizeof (int));
+  process->parser.exp_ops = vector_create (sizeof (struct parser_exp_op));
+  process->strings = intern_create ();
+  process->ast = ast_create (process->strings);
+  process->arena = arena_create ();
+  process->datatypes = datatypes_create (process->arena);
+  symres_init (process);
 
   process->flags = flags;
+  process->diagnostics = diagnostics;
   process->cfile.fp = f;
+  process->cfile.abs_path = fname;
   process->out_file = outf;
+
+  // the first line starts right at the beginning
+  unsigned int first_line = 0;
+  process->cfile.line_starts = vector_create (sizeof (unsigned int));
+  vector_push (process->cfile.line_starts, &first_line);
+
+  compile_process_load_input (process);
   return process;
 }
 
+void
+compile_process_free (struct compile_process *process)
+{
+  ast_free (process->ast);
+  datatypes_free (process->datatypes);
+  symres_free (process);
+  scope_free_root (process);
+  arena_free (process->arena);
+  intern_free (process->strings);
+  vector_free (process->node_vec);
+  vector_free (process->node_tree_vec);
+  vector_free (process->parser.exp_ops);
+  vector_free (process->cfile.line_starts);
+
+  if (process->cfile.mapped)
+    munmap ((void *)process->cfile.data, process->cfile.size);
+  else if (process->cfile.size)
+    free ((void *)process->cfile.data);
+
+  fclose (process->cfile.fp);
+  if (process->out_file)
+    fclose (process->out_file);
+
+  free (process);
+}
+
+void
+compile_process_copy (struct compile_process *copy,
+                      struct compile_process *process)
+{
+  // the lexer writes to the strings, the position in the input and the line
+  // starts (when reporting an error), those can't be shared
+  *copy = *process;
+  copy->strings = intern_create ();
+
+  unsigned int first_line = 0;
+  copy->cfile.line_starts = vector_create (sizeof (unsigned int));
+  vector_push (copy->cfile.line_starts, &first_line);
+  copy->cfile.line_starts_scanned = 0;
+}
+
+void
+compile_process_free_copy (struct compile_process *copy)
+{
+  vector_free (copy->cfile.line_starts);
+  intern_free (copy->strings);
+}
+
 char
 compile_process_next_char (struct lex_process *lex_process)
 {
   struct compile_process *compiler = lex_process->compiler;
-  compiler->pos.col += 1;
   char c = getc (compiler->cfile.fp);
+  if (c == EOF)
+    return c;
+
+  // we won't be able to look at what we read later on, so lines have to be
+  // recorded now
+  unsigned int offset = ++compiler->cfile.offset;
   if (c == '\n')
     {
-      compiler->pos.line += 1;
-      compiler->pos.col = 1;
+      vector_push (compiler->cfile.line_starts, &offset);
     }
 
   return c;
@@ -70,4 +188,101 @@ compile_process_push_char (struct lex_process *lex_process, char c)
 {
   struct compile_process *compiler = lex_process->compiler;
   ungetc (c, compiler->cfile.fp);
+
+  compiler->cfile.offset--;
+  if (c == '\n')
+    {
+      vector_pop (compiler->cfile.line_starts);
+    }
+}
+
+char
+compile_process_mem_next_char (struct lex_process *lex_process)
+{
+  struct compile_process *compiler = lex_process->compiler;
+  if (compiler->cfile.offset >= compiler->cfile.size)
+    return EOF;
+
+  return compiler->cfile.data[compiler->cfile.offset++];
+}
+
+char
+compile_process_mem_peek_char (struct lex_process *lex_process)
+{
+  struct compile_process *compiler = lex_process->compiler;
+  if (compiler->cfile.offset >= compiler->cfile.size)
+    return EOF;
+
+  return compiler->cfile.data[compiler->cfile.offset];
+}
+
+void
+compile_process_mem_push_char (struct lex_process *lex_process, char c)
+{
+  // the input is read only, so we can only give back what we've just read
+  struct compile_process *compiler = lex_process->compiler;
+  assert (compiler->cfile.offset > 0);
+  assert (compiler->cfile.data[compiler->cfile.offset - 1] == c);
+  compiler->cfile.offset--;
+}
+
+const char *
+compile_process_mem_input (struct lex_process *lex_process, size_t *left)
+{
+  struct compile_process *compiler = lex_process->compiler;
+  *left = compiler->cfile.size - compiler->cfile.offset;
+  return compiler->cfile.data + compiler->cfile.offset;
+}
+
+void
+compile_process_mem_skip_chars (struct lex_process *lex_process, size_t n)
+{
+  struct compile_process *compiler = lex_process->compiler;
+  assert (compiler->cfile.offset + n <= compiler->cfile.size);
+  compiler->cfile.offset += n;
+}
+
+// returns the offsets where every line starts, looking for them first if the
+// input is in memory and nobody asked before
+static struct vector *
+compile_process_line_starts (struct compile_process *process)
+{
+  struct compile_process_input_file *cfile = &process->cfile;
+  if (!cfile->data || cfile->line_starts_scanned)
+    return cfile->line_starts;
+
+  const char *end = cfile->data + cfile->size;
+  const char *newline = memchr (cfile->data, '\n', cfile->size);
+  while (newline)
+    {
+      unsigned int offset = newline + 1 - cfile->data;
+      vector_push (cfile->line_starts, &offset);
+      newline = memchr (newline + 1, '\n', end - (newline + 1));
+    }
+
+  cfile->line_starts_scanned = 1;
+  return cfile->line_starts;
+}
+
+struct pos
+compile_process_pos (struct compile_process *process, unsigned int offset)
+{
+  struct vector *lines = compile_process_line_starts (process);
+  unsigned int *line_starts = vector_at (lines, 0);
+
+  // find the last line that starts at or before `offset'
+  int low = 0;
+  int high = vector_count (lines) - 1;
+  while (low < high)
+    {
+      int mid = low + (high - low + 1) / 2;
+      if (line_starts[mid] <= offset)
+        low = mid;
+      else
+        high = mid - 1;
+    }
+
+  return (struct pos){ .line = low + 1,
+                       .col = offset - line_starts[low] + 1,
+                       .fname = process->cfile.abs_path };
 }
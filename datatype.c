@@ -7,7 +7,131 @@
 #include "compiler.h"
 
 _Bool
-datatype_is_struct_or_union_for_name (const char *name)
+datatype_is_struct_or_union_for_keyword (int keyword)
 {
-  return S_EQ (name, "union") || S_EQ (name, "struct");
+  return keyword == KEYWORD_UNION || keyword == KEYWORD_STRUCT;
+}
+
+#define DATATYPES_INITIAL_CAPACITY 64
+
+static unsigned int
+datatype_hash (const struct datatype *dtype)
+{
+  // FNV-1a over the fields, secondaries and names are unique so their
+  // addresses will do
+  unsigned long long fields[] = { dtype->flags,
+                                  dtype->type,
+                                  (size_t)dtype->secondary,
+                                  (size_t)dtype->type_str,
+                                  dtype->size,
+                                  dtype->pointer_depth,
+                                  dtype->struct_node };
+
+  unsigned int hash = 2166136261u;
+  for (size_t i = 0; i < sizeof (fields) / sizeof (fields[0]); i++)
+    {
+      hash ^= fields[i] ^ (fields[i] >> 32);
+      hash *= 16777619u;
+    }
+
+  return hash;
+}
+
+static _Bool
+datatype_equals (const struct datatype *a, const struct datatype *b)
+{
+  return a->flags == b->flags && a->type == b->type
+         && a->secondary == b->secondary && a->type_str == b->type_str
+         && a->size == b->size && a->pointer_depth == b->pointer_depth
+         && a->struct_node == b->struct_node;
+}
+
+// the slot `dtype' is in, or the empty one where it would go
+static int *
+datatypes_slot (struct datatypes *datatypes, const struct datatype *dtype)
+{
+  int mask = datatypes->capacity - 1;
+  int index = datatype_hash (dtype) & mask;
+  while (datatypes->slots[index])
+    {
+      int id = datatypes->slots[index] - 1;
+      if (datatype_equals (datatype_get (datatypes, id), dtype))
+        break;
+
+      index = (index + 1) & mask;
+    }
+
+  return &datatypes->slots[index];
+}
+
+static void
+datatypes_grow (struct datatypes *datatypes)
+{
+  free (datatypes->slots);
+  datatypes->capacity *= 2;
+  datatypes->slots = calloc (datatypes->capacity, sizeof (int));
+  assert (datatypes->slots);
+
+  // all the datatypes are different, they just need an empty slot
+  for (int id = 0; id < vector_count (datatypes->types); id++)
+    *datatypes_slot (datatypes, datatype_get (datatypes, id)) = id + 1;
+}
+
+struct datatypes *
+datatypes_create (struct arena *arena)
+{
+  struct datatypes *datatypes = calloc (1, sizeof (struct datatypes));
+  datatypes->capacity = DATATYPES_INITIAL_CAPACITY;
+  datatypes->slots = calloc (datatypes->capacity, sizeof (int));
+  datatypes->types = vector_create (sizeof (const struct datatype *));
+  datatypes->arena = arena;
+  return datatypes;
+}
+
+void
+datatypes_free (struct datatypes *datatypes)
+{
+  free (datatypes->slots);
+  vector_free (datatypes->types);
+  free (datatypes);
+}
+
+int
+datatype_intern (struct datatypes *datatypes, const struct datatype *dtype)
+{
+  int *slot = datatypes_slot (datatypes, dtype);
+  if (*slot)
+    return *slot - 1;
+
+  struct datatype *copy
+      = arena_alloc (datatypes->arena, sizeof (struct datatype));
+  *copy = *dtype;
+  vector_push (datatypes->types, &copy);
+
+  int id = vector_count (datatypes->types) - 1;
+  *slot = id + 1;
+
+  // keep the load factor under 3/4
+  if ((id + 1) * 4 >= datatypes->capacity * 3)
+    datatypes_grow (datatypes);
+
+  return id;
+}
+
+const struct datatype *
+datatype_get (struct datatypes *datatypes, int id)
+{
+  return *(const struct datatype **)vector_at (datatypes->types, id);
+}
+
+void
+datatypes_truncate (struct datatypes *datatypes, int count)
+{
+  // removing the newest first leaves the table as if they had never been
+  // added, so their slots can simply be emptied
+  for (int id = vector_count (datatypes->types) - 1; id >= count; id--)
+    {
+      *datatypes_slot (datatypes, datatype_get (datatypes, id)) = 0;
+      vector_pop (datatypes->types);
+    }
 }
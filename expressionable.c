@@ -5,34 +5,388 @@
  */
 #include "compiler.h"
 
-// format: {op1, op2, op3, ..., NULL}
+#include <limits.h>
+
+// format: {op1, op2, op3, ..., OPERATOR_NONE}
 struct expressionable_op_precedence_group op_precedence[TOTAL_OPERATOR_GROUPS]
-    = { { .operators = { "++", "--", "()", "[]", "(", "[", ".", "->", NULL },
+    = { { .operators = { OPERATOR_INCREMENT, OPERATOR_DECREMENT, OPERATOR_CALL,
+                         OPERATOR_SUBSCRIPT, OPERATOR_LEFT_PARENTHESES,
+                         OPERATOR_LEFT_BRACKET, OPERATOR_DOT, OPERATOR_ARROW,
+                         OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "*", "/", "%", NULL },
+        { .operators = { OPERATOR_MULTIPLY, OPERATOR_DIVIDE, OPERATOR_MODULO,
+                         OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "+", "-", NULL },
+        { .operators = { OPERATOR_PLUS, OPERATOR_MINUS, OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "<<", ">>", NULL },
+        { .operators = { OPERATOR_LEFT_SHIFT, OPERATOR_RIGHT_SHIFT,
+                         OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "<", "<=", ">", ">=", NULL },
+        { .operators = { OPERATOR_LESS, OPERATOR_LESS_EQUAL, OPERATOR_GREATER,
+                         OPERATOR_GREATER_EQUAL, OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "==", "!=", NULL },
+        { .operators = { OPERATOR_EQUAL, OPERATOR_NOT_EQUAL, OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "&", NULL },
+        { .operators = { OPERATOR_BITWISE_AND, OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "^", NULL },
+        { .operators = { OPERATOR_BITWISE_XOR, OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "|", NULL },
+        { .operators = { OPERATOR_BITWISE_OR, OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "&&", NULL },
+        { .operators = { OPERATOR_LOGICAL_AND, OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "||", NULL },
+        { .operators = { OPERATOR_LOGICAL_OR, OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT },
-        { .operators = { "?", ":", NULL },
+        { .operators = { OPERATOR_QUESTION, OPERATOR_COLON, OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT },
-        { .operators = { "=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=", "&=",
-                         "^=", "|=", NULL },
+        { .operators = { OPERATOR_ASSIGN, OPERATOR_ADD_ASSIGN,
+                         OPERATOR_SUB_ASSIGN, OPERATOR_MUL_ASSIGN,
+                         OPERATOR_DIV_ASSIGN, OPERATOR_MOD_ASSIGN,
+                         OPERATOR_LEFT_SHIFT_ASSIGN,
+                         OPERATOR_RIGHT_SHIFT_ASSIGN, OPERATOR_AND_ASSIGN,
+                         OPERATOR_XOR_ASSIGN, OPERATOR_OR_ASSIGN,
+                         OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_RIGHT_TO_LEFT },
-        { .operators = { ",", NULL },
+        { .operators = { OPERATOR_COMMA, OPERATOR_NONE },
           .associativity = ASSOCIATIVITY_LEFT_TO_RIGHT } };
+
+// operator -> index of its group in op_precedence, -1 if it has none. Built
+// once from op_precedence before main runs.
+static int op_precedence_index[OPERATOR_TOTAL];
+
+__attribute__ ((constructor)) static void
+expressionable_build_precedence_index ()
+{
+  for (int i = 0; i < OPERATOR_TOTAL; i++)
+    op_precedence_index[i] = -1;
+
+  for (int i = 0; i < TOTAL_OPERATOR_GROUPS; i++)
+    {
+      for (int j = 0; op_precedence[i].operators[j] != OPERATOR_NONE; j++)
+        op_precedence_index[op_precedence[i].operators[j]] = i;
+    }
+}
+
+int
+expressionable_op_precedence (
+    int op, struct expressionable_op_precedence_group **group_out)
+{
+  int precedence = op_precedence_index[op];
+  *group_out = precedence >= 0 ? &op_precedence[precedence] : NULL;
+  return precedence;
+}
+
+static int
+expressionable_int_rank (int type)
+{
+  return type == NUMBER_TYPE_NORMAL ? 0 : type == NUMBER_TYPE_LONG ? 1 : 2;
+}
+
+static int
+expressionable_float_rank (int type)
+{
+  return type == NUMBER_TYPE_FLOAT ? 0 : type == NUMBER_TYPE_DOUBLE ? 1 : 2;
+}
+
+// the type both integer operands are converted to before `op' (the usual
+// arithmetic conversions)
+static struct token_number
+expressionable_common_int_type (struct token_number left,
+                                struct token_number right)
+{
+  _Bool left_unsigned = left.flags & NUMBER_FLAG_UNSIGNED;
+  _Bool right_unsigned = right.flags & NUMBER_FLAG_UNSIGNED;
+  if (left_unsigned == right_unsigned)
+    {
+      return expressionable_int_rank (left.type)
+                     >= expressionable_int_rank (right.type)
+                 ? left
+                 : right;
+    }
+
+  struct token_number sign = left_unsigned ? right : left;
+  struct token_number unsign = left_unsigned ? left : right;
+  if (expressionable_int_rank (unsign.type)
+      >= expressionable_int_rank (sign.type))
+    return unsign;
+
+  // the signed type wins if it can hold every value of the unsigned one,
+  // otherwise it's its unsigned version (i.e. long and unsigned int)
+  if (number_integer_bits (sign.type) > number_integer_bits (unsign.type))
+    return sign;
+
+  sign.flags |= NUMBER_FLAG_UNSIGNED;
+  return sign;
+}
+
+// cuts `value' down to the width of `num', sign extending it if it's signed
+static unsigned long long
+expressionable_int_wrap (unsigned long long value, struct token_number num)
+{
+  if (number_integer_bits (num.type) == 64)
+    return value;
+
+  value &= UINT_MAX;
+  if (!(num.flags & NUMBER_FLAG_UNSIGNED) && value > INT_MAX)
+    value |= ~(unsigned long long)UINT_MAX;
+
+  return value;
+}
+
+static void
+expressionable_make_int (struct node *out, unsigned long long value,
+                         struct token_number num)
+{
+  out->type = NODE_TYPE_NUMBER;
+  out->num = num;
+  out->llnum = expressionable_int_wrap (value, num);
+}
+
+static void
+expressionable_make_bool (struct node *out, _Bool value)
+{
+  expressionable_make_int (out, value,
+                           (struct token_number){ NUMBER_TYPE_NORMAL, 0 });
+}
+
+static _Bool
+expressionable_fold_compare (int op, int compare, struct node *out)
+{
+  switch (op)
+    {
+    case OPERATOR_LESS:
+      expressionable_make_bool (out, compare < 0);
+      return 1;
+
+    case OPERATOR_LESS_EQUAL:
+      expressionable_make_bool (out, compare <= 0);
+      return 1;
+
+    case OPERATOR_GREATER:
+      expressionable_make_bool (out, compare > 0);
+      return 1;
+
+    case OPERATOR_GREATER_EQUAL:
+      expressionable_make_bool (out, compare >= 0);
+      return 1;
+
+    case OPERATOR_EQUAL:
+      expressionable_make_bool (out, compare == 0);
+      return 1;
+
+    case OPERATOR_NOT_EQUAL:
+      expressionable_make_bool (out, compare != 0);
+      return 1;
+    }
+
+  return 0;
+}
+
+static double
+expressionable_to_double (struct node *node)
+{
+  if (number_is_float (node->num.type))
+    return node->dval;
+
+  if (node->num.flags & NUMBER_FLAG_UNSIGNED)
+    return (double)node->llnum;
+
+  return (double)(long long)node->llnum;
+}
+
+static _Bool
+expressionable_fold_float (int op, struct node *left, struct node *right,
+                           struct node *out)
+{
+  int type = left->num.type;
+  if (!number_is_float (type)
+      || (number_is_float (right->num.type)
+          && expressionable_float_rank (right->num.type)
+                 > expressionable_float_rank (type)))
+    type = right->num.type;
+
+  double a = expressionable_to_double (left);
+  double b = expressionable_to_double (right);
+  double res = 0;
+  switch (op)
+    {
+    case OPERATOR_PLUS:
+      res = a + b;
+      break;
+
+    case OPERATOR_MINUS:
+      res = a - b;
+      break;
+
+    case OPERATOR_MULTIPLY:
+      res = a * b;
+      break;
+
+    case OPERATOR_DIVIDE:
+      res = a / b;
+      break;
+
+    default:
+      // comparisons with a NaN are left alone
+      if (a != a || b != b)
+        return 0;
+
+      return expressionable_fold_compare (op, (a > b) - (a < b), out);
+    }
+
+  out->type = NODE_TYPE_NUMBER;
+  out->num = (struct token_number){ .type = type };
+  out->dval = type == NUMBER_TYPE_FLOAT ? (float)res : res;
+  return 1;
+}
+
+static _Bool
+expressionable_fold_shift (struct compile_process *process, int op,
+                           struct node *left, struct node *right,
+                           struct node *out)
+{
+  // the result has the type of the left operand alone
+  struct token_number num = left->num;
+  int bits = number_integer_bits (num.type);
+  _Bool is_signed = !(num.flags & NUMBER_FLAG_UNSIGNED);
+
+  long long count = right->llnum;
+  if ((right->num.flags & NUMBER_FLAG_UNSIGNED) && right->llnum >= 64)
+    count = 64;
+
+  if (count < 0 || count >= bits)
+    {
+      compiler_warning (process, "Shift count is out of range");
+      return 0;
+    }
+
+  unsigned long long value = left->llnum;
+  if (op == OPERATOR_RIGHT_SHIFT)
+    {
+      // signed values are shifted arithmetically, like every compiler does
+      value = is_signed ? (unsigned long long)((long long)value >> count)
+                        : value >> count;
+      expressionable_make_int (out, value, num);
+      return 1;
+    }
+
+  unsigned long long res = expressionable_int_wrap (value << count, num);
+  if (is_signed
+      && ((long long)value < 0 || (long long)res >> count != (long long)value))
+    compiler_warning (process, "Integer overflow in expression");
+
+  expressionable_make_int (out, res, num);
+  return 1;
+}
+
+static _Bool
+expressionable_fold_int (struct compile_process *process, int op,
+                         struct node *left, struct node *right,
+                         struct node *out)
+{
+  if (op == OPERATOR_LEFT_SHIFT || op == OPERATOR_RIGHT_SHIFT)
+    return expressionable_fold_shift (process, op, left, right, out);
+
+  struct token_number num
+      = expressionable_common_int_type (left->num, right->num);
+  unsigned long long a = expressionable_int_wrap (left->llnum, num);
+  unsigned long long b = expressionable_int_wrap (right->llnum, num);
+  _Bool is_signed = !(num.flags & NUMBER_FLAG_UNSIGNED);
+  int compare = (a > b) - (a < b);
+  if (is_signed)
+    compare = ((long long)a > (long long)b) - ((long long)a < (long long)b);
+
+  if (expressionable_fold_compare (op, compare, out))
+    return 1;
+
+  if ((op == OPERATOR_DIVIDE || op == OPERATOR_MODULO) && b == 0)
+    {
+      compiler_warning (process, "Division by zero");
+      return 0;
+    }
+
+  // signed results are worked out in 64 bits, anything that doesn't fit
+  // in the type afterwards overflowed
+  long long res = 0;
+  _Bool overflow = 0;
+  switch (op)
+    {
+    case OPERATOR_PLUS:
+      overflow = __builtin_add_overflow ((long long)a, (long long)b, &res);
+      break;
+
+    case OPERATOR_MINUS:
+      overflow = __builtin_sub_overflow ((long long)a, (long long)b, &res);
+      break;
+
+    case OPERATOR_MULTIPLY:
+      overflow = __builtin_mul_overflow ((long long)a, (long long)b, &res);
+      break;
+
+    case OPERATOR_DIVIDE:
+    case OPERATOR_MODULO:
+      if (is_signed && (long long)a == LLONG_MIN && (long long)b == -1)
+        {
+          overflow = op == OPERATOR_DIVIDE;
+          res = op == OPERATOR_DIVIDE ? LLONG_MIN : 0;
+        }
+      else if (is_signed)
+        {
+          res = op == OPERATOR_DIVIDE ? (long long)a / (long long)b
+                                      : (long long)a % (long long)b;
+        }
+      else
+        {
+          res = op == OPERATOR_DIVIDE ? a / b : a % b;
+        }
+      break;
+
+    case OPERATOR_BITWISE_AND:
+      res = a & b;
+      break;
+
+    case OPERATOR_BITWISE_XOR:
+      res = a ^ b;
+      break;
+
+    case OPERATOR_BITWISE_OR:
+      res = a | b;
+      break;
+
+    default:
+      return 0;
+    }
+
+  if (is_signed)
+    {
+      if (!overflow && number_integer_bits (num.type) == 32)
+        overflow = res < INT_MIN || res > INT_MAX;
+
+      if (overflow)
+        compiler_warning (process, "Integer overflow in expression");
+    }
+
+  expressionable_make_int (out, res, num);
+  return 1;
+}
+
+_Bool
+expressionable_fold (struct compile_process *process, int op,
+                     struct node *left, struct node *right, struct node *out)
+{
+  assert (left->type == NODE_TYPE_NUMBER && right->type == NODE_TYPE_NUMBER);
+
+  if (op == OPERATOR_LOGICAL_AND || op == OPERATOR_LOGICAL_OR)
+    {
+      _Bool a = expressionable_to_double (left) != 0;
+      _Bool b = expressionable_to_double (right) != 0;
+      expressionable_make_bool (out, op == OPERATOR_LOGICAL_AND ? a && b
+                                                                : a || b);
+      return 1;
+    }
+
+  if (number_is_float (left->num.type) || number_is_float (right->num.type))
+    return expressionable_fold_float (op, left, right, out);
+
+  return expressionable_fold_int (process, op, left, right, out);
+}
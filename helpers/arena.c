@@ -0,0 +1,102 @@
+#include "arena.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct arena_chunk *
+arena_chunk_create (size_t size, struct arena_chunk *next)
+{
+  // memory is only reused after a rewind, which zeroes it again
+  struct arena_chunk *chunk = calloc (1, sizeof (struct arena_chunk) + size);
+  assert (chunk);
+  chunk->next = next;
+  chunk->used = 0;
+  chunk->size = size;
+  return chunk;
+}
+
+struct arena *
+arena_create ()
+{
+  struct arena *arena = calloc (1, sizeof (struct arena));
+  arena->chunk = arena_chunk_create (ARENA_CHUNK_SIZE, NULL);
+  return arena;
+}
+
+void
+arena_free (struct arena *arena)
+{
+  struct arena_chunk *chunk = arena->chunk;
+  while (chunk)
+    {
+      struct arena_chunk *next = chunk->next;
+      free (chunk);
+      chunk = next;
+    }
+
+  free (arena);
+}
+
+void *
+arena_alloc (struct arena *arena, size_t size)
+{
+  size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+  struct arena_chunk *chunk = arena->chunk;
+  if (chunk->size - chunk->used < size)
+    {
+      if (size > ARENA_CHUNK_SIZE / 4)
+        {
+          // big allocations get a chunk of their own, behind the current
+          // one so we can keep filling it
+          chunk->next = arena_chunk_create (size, chunk->next);
+          chunk = chunk->next;
+        }
+      else
+        {
+          chunk = arena_chunk_create (ARENA_CHUNK_SIZE, chunk);
+          arena->chunk = chunk;
+        }
+    }
+
+  void *ptr = chunk->data + chunk->used;
+  chunk->used += size;
+  arena->allocated += size;
+  return ptr;
+}
+
+struct arena_mark
+arena_mark (struct arena *arena)
+{
+  return (struct arena_mark){ .chunk = arena->chunk,
+                              .used = arena->chunk->used,
+                              .allocated = arena->allocated,
+                              .next = arena->chunk->next };
+}
+
+static void
+arena_free_chunks (struct arena_chunk *chunk, struct arena_chunk *end)
+{
+  while (chunk != end)
+    {
+      struct arena_chunk *next = chunk->next;
+      free (chunk);
+      chunk = next;
+    }
+}
+
+void
+arena_rewind (struct arena *arena, struct arena_mark mark)
+{
+  // chunks started after the mark
+  arena_free_chunks (arena->chunk, mark.chunk);
+  arena_free_chunks (mark.chunk->next, mark.next);
+
+  struct arena_chunk *chunk = mark.chunk;
+  memset (chunk->data + mark.used, 0, chunk->used - mark.used);
+  chunk->used = mark.used;
+  chunk->next = mark.next;
+  arena->chunk = chunk;
+  arena->allocated = mark.allocated;
+}
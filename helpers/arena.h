@@ -0,0 +1,62 @@
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <stddef.h>
+
+// Memory is taken from the system in chunks of at least this size
+#define ARENA_CHUNK_SIZE 65536
+
+// Every allocation is aligned to this
+#define ARENA_ALIGNMENT 16
+
+struct arena_chunk
+{
+  struct arena_chunk *next;
+  size_t used;
+  size_t size;
+  _Alignas (ARENA_ALIGNMENT) char data[];
+};
+
+/**
+ * A region of memory that's handed out by bumping a pointer. Allocations
+ * can't be freed one by one, they all go away with the arena or with a
+ * rewind to a mark taken before them.
+ */
+struct arena
+{
+  // Chunk we are allocating from, older chunks are chained through `next'
+  struct arena_chunk *chunk;
+
+  // Bytes handed out so far
+  size_t allocated;
+};
+
+// Where an arena was at some point, see arena_rewind
+struct arena_mark
+{
+  struct arena_chunk *chunk;
+  size_t used;
+  size_t allocated;
+
+  // Big allocations go right behind the current chunk, everything between
+  // `chunk' and this one came after the mark
+  struct arena_chunk *next;
+};
+
+struct arena *arena_create ();
+void arena_free (struct arena *arena);
+
+/**
+ * Returns `size' bytes of zeroed memory that live as long as the arena
+ */
+void *arena_alloc (struct arena *arena, size_t size);
+
+struct arena_mark arena_mark (struct arena *arena);
+
+/**
+ * Frees everything allocated since `mark' was taken. Marks taken after it
+ * become invalid
+ */
+void arena_rewind (struct arena *arena, struct arena_mark mark);
+
+#endif
@@ -69,6 +69,13 @@ buffer_write (struct buffer *buffer, char c)
   buffer->len++;
 }
 
+void
+buffer_clear (struct buffer *buffer)
+{
+  buffer->len = 0;
+  buffer->rindex = 0;
+}
+
 void *
 buffer_ptr (struct buffer *buffer)
 {
@@ -23,6 +23,7 @@ void buffer_extend (struct buffer *buffer, size_t size);
 void buffer_printf (struct buffer *buffer, const char *fmt, ...);
 void buffer_printf_no_terminator (struct buffer *buffer, const char *fmt, ...);
 void buffer_write (struct buffer *buffer, char c);
+void buffer_clear (struct buffer *buffer);
 void *buffer_ptr (struct buffer *buffer);
 void buffer_free (struct buffer *buffer);
 
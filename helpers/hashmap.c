@@ -0,0 +1,114 @@
+#include "hashmap.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t
+hashmap_hash (const void *key)
+{
+  // Fibonacci hashing, the low bits of an address are mostly alignment so
+  // the high bits of the product are folded back in
+  uint64_t hash = (uintptr_t)key * 11400714819323198485ull;
+  return hash ^ (hash >> 32);
+}
+
+static struct hashmap_entry *
+hashmap_slot (struct hashmap_entry *entries, size_t capacity, const void *key)
+{
+  size_t mask = capacity - 1;
+  size_t index = hashmap_hash (key) & mask;
+  while (entries[index].key && entries[index].key != key)
+    index = (index + 1) & mask;
+
+  return &entries[index];
+}
+
+static void
+hashmap_grow (struct hashmap *map)
+{
+  size_t new_capacity = map->capacity * 2;
+  struct hashmap_entry *new_entries
+      = calloc (new_capacity, sizeof (struct hashmap_entry));
+  assert (new_entries);
+
+  for (size_t i = 0; i < map->capacity; i++)
+    {
+      struct hashmap_entry *entry = &map->entries[i];
+      if (entry->key)
+        *hashmap_slot (new_entries, new_capacity, entry->key) = *entry;
+    }
+
+  free (map->entries);
+  map->entries = new_entries;
+  map->capacity = new_capacity;
+}
+
+struct hashmap *
+hashmap_create ()
+{
+  struct hashmap *map = calloc (1, sizeof (struct hashmap));
+  assert (map);
+  map->capacity = HASHMAP_INITIAL_CAPACITY;
+  map->entries = calloc (map->capacity, sizeof (struct hashmap_entry));
+  assert (map->entries);
+  return map;
+}
+
+void
+hashmap_free (struct hashmap *map)
+{
+  free (map->entries);
+  free (map);
+}
+
+void *
+hashmap_get (struct hashmap *map, const void *key)
+{
+  return hashmap_slot (map->entries, map->capacity, key)->value;
+}
+
+void
+hashmap_set (struct hashmap *map, const void *key, void *value)
+{
+  assert (key);
+  struct hashmap_entry *entry
+      = hashmap_slot (map->entries, map->capacity, key);
+  entry->value = value;
+  if (entry->key)
+    return;
+
+  entry->key = key;
+  map->count++;
+
+  // keep the load factor under 3/4
+  if (map->count * 4 >= map->capacity * 3)
+    hashmap_grow (map);
+}
+
+void
+hashmap_clear (struct hashmap *map)
+{
+  if (map->count == 0)
+    return;
+
+  // a table that's mostly empty is swapped for one that fits what it had,
+  // so clearing it costs about as much as filling it did
+  if (map->capacity > HASHMAP_INITIAL_CAPACITY
+      && map->count * 4 < map->capacity)
+    {
+      size_t capacity = HASHMAP_INITIAL_CAPACITY;
+      while (map->count * 4 >= capacity * 3)
+        capacity *= 2;
+
+      free (map->entries);
+      map->entries = calloc (capacity, sizeof (struct hashmap_entry));
+      assert (map->entries);
+      map->capacity = capacity;
+    }
+  else
+    memset (map->entries, 0, map->capacity * sizeof (struct hashmap_entry));
+
+  map->count = 0;
+}
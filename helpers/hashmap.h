@@ -0,0 +1,47 @@
+#ifndef __HASHMAP_H
+#define __HASHMAP_H
+
+#include <stddef.h>
+
+// Initial amount of slots of a map, must be a power of two
+#define HASHMAP_INITIAL_CAPACITY 16
+
+struct hashmap_entry
+{
+  const void *key;
+  void *value;
+};
+
+/**
+ * A hash table keyed by address, with open addressing. Keys are compared by
+ * address only, so they are meant to be interned strings or some other
+ * unique pointer. NULL can't be used as a key.
+ */
+struct hashmap
+{
+  struct hashmap_entry *entries;
+  // Always a power of two
+  size_t capacity;
+  size_t count;
+};
+
+struct hashmap *hashmap_create ();
+void hashmap_free (struct hashmap *map);
+
+/**
+ * Returns the value of `key', or NULL if it isn't in the map
+ */
+void *hashmap_get (struct hashmap *map, const void *key);
+
+/**
+ * Sets the value of `key', adding it if it isn't in the map yet
+ */
+void hashmap_set (struct hashmap *map, const void *key, void *value);
+
+/**
+ * Removes every key, keeping the memory around for the next ones. A map
+ * that was mostly empty shrinks to fit the keys it had
+ */
+void hashmap_clear (struct hashmap *map);
+
+#endif
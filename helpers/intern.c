@@ -0,0 +1,199 @@
+#include "intern.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int
+intern_hash (const char *str, size_t len)
+{
+  // FNV-1a
+  unsigned int hash = 2166136261u;
+  for (size_t i = 0; i < len; i++)
+    {
+      hash ^= (unsigned char)str[i];
+      hash *= 16777619u;
+    }
+
+  return hash;
+}
+
+static struct intern_chunk *
+intern_chunk_create (size_t size, struct intern_chunk *next)
+{
+  struct intern_chunk *chunk = malloc (sizeof (struct intern_chunk) + size);
+  assert (chunk);
+  chunk->next = next;
+  chunk->used = 0;
+  chunk->size = size;
+  return chunk;
+}
+
+struct intern *
+intern_create ()
+{
+  struct intern *intern = calloc (1, sizeof (struct intern));
+  intern->capacity = INTERN_INITIAL_CAPACITY;
+  intern->entries = calloc (intern->capacity, sizeof (struct intern_entry));
+  intern->strings_capacity = INTERN_INITIAL_CAPACITY;
+  intern->strings = malloc (intern->strings_capacity * sizeof (const char *));
+  intern->chunk = intern_chunk_create (INTERN_CHUNK_SIZE, NULL);
+  return intern;
+}
+
+void
+intern_free (struct intern *intern)
+{
+  struct intern_chunk *chunk = intern->chunk;
+  while (chunk)
+    {
+      struct intern_chunk *next = chunk->next;
+      free (chunk);
+      chunk = next;
+    }
+
+  free (intern->entries);
+  free (intern->strings);
+  free (intern);
+}
+
+static struct intern_entry *
+intern_slot (struct intern_entry *entries, size_t capacity, const char *str,
+             size_t len, unsigned int hash)
+{
+  size_t mask = capacity - 1;
+  size_t index = hash & mask;
+  while (entries[index].str)
+    {
+      struct intern_entry *entry = &entries[index];
+      if (entry->hash == hash && entry->len == len
+          && memcmp (entry->str, str, len) == 0)
+        break;
+
+      index = (index + 1) & mask;
+    }
+
+  return &entries[index];
+}
+
+static void
+intern_grow (struct intern *intern)
+{
+  size_t new_capacity = intern->capacity * 2;
+  struct intern_entry *new_entries
+      = calloc (new_capacity, sizeof (struct intern_entry));
+  assert (new_entries);
+
+  for (size_t i = 0; i < intern->capacity; i++)
+    {
+      struct intern_entry *entry = &intern->entries[i];
+      if (!entry->str)
+        continue;
+
+      // all the strings are unique, so just look for an empty slot
+      size_t index = entry->hash & (new_capacity - 1);
+      while (new_entries[index].str)
+        index = (index + 1) & (new_capacity - 1);
+
+      new_entries[index] = *entry;
+    }
+
+  free (intern->entries);
+  intern->entries = new_entries;
+  intern->capacity = new_capacity;
+}
+
+static const char *
+intern_copy (struct intern *intern, const char *str, size_t len,
+             unsigned int id)
+{
+  struct intern_header header = { .id = id, .len = len };
+  size_t needed = sizeof (header) + len + 1;
+
+  struct intern_chunk *chunk = intern->chunk;
+  if (chunk->size - chunk->used < needed)
+    {
+      size_t size = needed > INTERN_CHUNK_SIZE ? needed : INTERN_CHUNK_SIZE;
+      chunk = intern_chunk_create (size, chunk);
+      intern->chunk = chunk;
+    }
+
+  char *start = &chunk->data[chunk->used];
+  memcpy (start, &header, sizeof (header));
+
+  char *copy = start + sizeof (header);
+  memcpy (copy, str, len);
+  copy[len] = 0x00;
+  chunk->used += needed;
+  return copy;
+}
+
+const char *
+intern_str (struct intern *intern, const char *str, size_t len)
+{
+  unsigned int hash = intern_hash (str, len);
+  struct intern_entry *entry
+      = intern_slot (intern->entries, intern->capacity, str, len, hash);
+  if (entry->str)
+    return entry->str;
+
+  if (intern->count == intern->strings_capacity)
+    {
+      intern->strings_capacity *= 2;
+      intern->strings = realloc (intern->strings, intern->strings_capacity
+                                                      * sizeof (const char *));
+      assert (intern->strings);
+    }
+
+  entry->str = intern_copy (intern, str, len, intern->count);
+  entry->len = len;
+  entry->hash = hash;
+  intern->strings[intern->count] = entry->str;
+  intern->count++;
+
+  const char *res = entry->str;
+
+  // keep the load factor under 3/4
+  if (intern->count * 4 >= intern->capacity * 3)
+    intern_grow (intern);
+
+  return res;
+}
+
+const char *
+intern_cstr (struct intern *intern, const char *str)
+{
+  return intern_str (intern, str, strlen (str));
+}
+
+unsigned int
+intern_id (struct intern *intern, const char *str)
+{
+  struct intern_header header;
+  memcpy (&header, str - sizeof (header), sizeof (header));
+  assert (header.id < intern->count && intern->strings[header.id] == str);
+  return header.id;
+}
+
+size_t
+intern_len (struct intern *intern, const char *str)
+{
+  struct intern_header header;
+  memcpy (&header, str - sizeof (header), sizeof (header));
+  assert (header.id < intern->count && intern->strings[header.id] == str);
+  return header.len;
+}
+
+const char *
+intern_get (struct intern *intern, unsigned int id)
+{
+  assert (id < intern->count);
+  return intern->strings[id];
+}
+
+const char *
+intern_find (struct intern *intern, const char *str, size_t len)
+{
+  unsigned int hash = intern_hash (str, len);
+  return intern_slot (intern->entries, intern->capacity, str, len, hash)->str;
+}
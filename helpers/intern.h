@@ -0,0 +1,90 @@
+#ifndef __INTERN_H
+#define __INTERN_H
+
+#include <stddef.h>
+
+// Initial amount of slots of the hash table, must be a power of two
+#define INTERN_INITIAL_CAPACITY 1024
+
+// Strings are copied into chunks of at least this size
+#define INTERN_CHUNK_SIZE 65536
+
+struct intern_entry
+{
+  const char *str;
+  size_t len;
+  unsigned int hash;
+};
+
+// Every string in a chunk is preceded by its id and length
+struct intern_header
+{
+  unsigned int id;
+  unsigned int len;
+};
+
+struct intern_chunk
+{
+  struct intern_chunk *next;
+  size_t used;
+  size_t size;
+  char data[];
+};
+
+/**
+ * A table of unique strings. Interning the same characters twice gives back
+ * the same pointer, so interned strings can be compared by address. Every
+ * string also gets a small id, handy to refer to it in 32 bits. Strings
+ * live until the table is freed.
+ */
+struct intern
+{
+  struct intern_entry *entries;
+  // Always a power of two
+  size_t capacity;
+  size_t count;
+
+  // Interned strings by id
+  const char **strings;
+  size_t strings_capacity;
+
+  // Chunk we are currently copying strings into, older chunks are chained
+  // through `next'
+  struct intern_chunk *chunk;
+};
+
+struct intern *intern_create ();
+void intern_free (struct intern *intern);
+
+/**
+ * Returns the unique, null terminated copy of the `len' bytes at `str'
+ */
+const char *intern_str (struct intern *intern, const char *str, size_t len);
+
+/**
+ * Same as intern_str, but for null terminated strings
+ */
+const char *intern_cstr (struct intern *intern, const char *str);
+
+/**
+ * Returns the id of an interned string, `str' must come from this table
+ */
+unsigned int intern_id (struct intern *intern, const char *str);
+
+/**
+ * Returns the length of an interned string, which might have null
+ * characters in it. `str' must come from this table
+ */
+size_t intern_len (struct intern *intern, const char *str);
+
+/**
+ * Returns the interned string with the given id
+ */
+const char *intern_get (struct intern *intern, unsigned int id);
+
+/**
+ * Returns the interned copy of `str' or NULL if it was never interned
+ */
+const char *intern_find (struct intern *intern, const char *str, size_t len);
+
+#endif
@@ -0,0 +1,132 @@
+#include "pool.h"
+#include <assert.h>
+#include <stdlib.h>
+
+struct pool_worker
+{
+  struct pool *pool;
+  int id;
+  pthread_t thread;
+};
+
+// takes the next job of a queue, -1 if it's empty
+static int
+pool_queue_take (struct pool_queue *queue)
+{
+  int job = -1;
+  pthread_mutex_lock (&queue->lock);
+  if (queue->first < queue->end)
+    {
+      job = queue->first++;
+    }
+  pthread_mutex_unlock (&queue->lock);
+  return job;
+}
+
+// moves the second half of `victim' into the (empty) queue of `thief'.
+// Returns 0 if there was nothing to steal
+static _Bool
+pool_queue_steal (struct pool_queue *thief, struct pool_queue *victim)
+{
+  pthread_mutex_lock (&victim->lock);
+  int left = victim->end - victim->first;
+  if (left <= 0)
+    {
+      pthread_mutex_unlock (&victim->lock);
+      return 0;
+    }
+
+  // rounding up, so the last job left can be stolen too
+  int stolen = left - left / 2;
+  int end = victim->end;
+  victim->end -= stolen;
+  pthread_mutex_unlock (&victim->lock);
+
+  pthread_mutex_lock (&thief->lock);
+  thief->first = end - stolen;
+  thief->end = end;
+  pthread_mutex_unlock (&thief->lock);
+  return 1;
+}
+
+static void *
+pool_worker_main (void *arg)
+{
+  struct pool_worker *worker = arg;
+  struct pool *pool = worker->pool;
+  struct pool_queue *queue = &pool->queues[worker->id];
+
+  for (;;)
+    {
+      int job;
+      while ((job = pool_queue_take (queue)) >= 0)
+        {
+          pool->run (job, pool->private);
+        }
+
+      // our own queue is empty, look for work in the others starting with
+      // our neighbour so thieves spread out
+      _Bool stole = 0;
+      for (int i = 1; i < pool->workers && !stole; i++)
+        {
+          int victim = (worker->id + i) % pool->workers;
+          stole = pool_queue_steal (queue, &pool->queues[victim]);
+        }
+
+      // jobs are never added, so if every queue is empty we are done
+      if (!stole)
+        break;
+    }
+
+  return NULL;
+}
+
+void
+pool_run (int workers, int jobs, POOL_JOB run, void *private)
+{
+  if (workers > jobs)
+    workers = jobs;
+
+  if (workers < 1)
+    workers = 1;
+
+  struct pool pool = { .workers = workers, .run = run, .private = private };
+  pool.queues = calloc (workers, sizeof (struct pool_queue));
+  struct pool_worker *threads = calloc (workers, sizeof (struct pool_worker));
+  assert (pool.queues && threads);
+
+  for (int i = 0; i < workers; i++)
+    {
+      pthread_mutex_init (&pool.queues[i].lock, NULL);
+      pool.queues[i].first = (long)jobs * i / workers;
+      pool.queues[i].end = (long)jobs * (i + 1) / workers;
+      threads[i].pool = &pool;
+      threads[i].id = i;
+    }
+
+  // the calling thread is worker 0
+  for (int i = 1; i < workers; i++)
+    {
+      if (pthread_create (&threads[i].thread, NULL, pool_worker_main,
+                          &threads[i])
+          != 0)
+        {
+          // its jobs will be stolen by the rest
+          threads[i].pool = NULL;
+        }
+    }
+
+  pool_worker_main (&threads[0]);
+
+  for (int i = 1; i < workers; i++)
+    {
+      if (threads[i].pool)
+        pthread_join (threads[i].thread, NULL);
+    }
+
+  for (int i = 0; i < workers; i++)
+    pthread_mutex_destroy (&pool.queues[i].lock);
+
+  free (pool.queues);
+  free (threads);
+}
@@ -0,0 +1,37 @@
+#ifndef __POOL_H
+#define __POOL_H
+
+#include <pthread.h>
+
+typedef void (*POOL_JOB) (int job, void *private);
+
+// Jobs that are still waiting for a given worker, `first' is the next one it
+// takes and thieves split the range from `end'
+struct pool_queue
+{
+  pthread_mutex_t lock;
+  int first;
+  int end;
+};
+
+/**
+ * Runs a fixed number of jobs on a set of threads. Every worker starts with
+ * an even, contiguous share of the jobs and takes them in order; once it's
+ * done it steals the second half of whatever another worker has left.
+ */
+struct pool
+{
+  struct pool_queue *queues;
+  int workers;
+
+  POOL_JOB run;
+  void *private;
+};
+
+/**
+ * Calls `run' for every job in [0, jobs) using up to `workers' threads,
+ * including the calling one, and returns once all of them are done
+ */
+void pool_run (int workers, int jobs, POOL_JOB run, void *private);
+
+#endif
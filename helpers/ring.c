@@ -0,0 +1,104 @@
+#include "ring.h"
+
+#include <assert.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct ring *
+ring_create (size_t size, unsigned int capacity)
+{
+  assert (capacity && (capacity & (capacity - 1)) == 0);
+
+  // sizeof is a multiple of the alignment, as aligned_alloc wants
+  struct ring *ring = aligned_alloc (RING_CACHE_LINE, sizeof (struct ring));
+  assert (ring);
+  memset (ring, 0, sizeof (struct ring));
+  ring->data = malloc (size * capacity);
+  assert (ring->data);
+  ring->size = size;
+  ring->capacity = capacity;
+  ring->mask = capacity - 1;
+  atomic_init (&ring->head, 0);
+  atomic_init (&ring->tail, 0);
+  atomic_init (&ring->closed, 0);
+  return ring;
+}
+
+void
+ring_free (struct ring *ring)
+{
+  free (ring->data);
+  free (ring);
+}
+
+// the other side is usually close behind, so we check again a few times
+// before giving up the CPU
+static void
+ring_wait (int *spins)
+{
+  if (++*spins < RING_SPINS)
+    return;
+
+  *spins = 0;
+  sched_yield ();
+}
+
+void
+ring_push (struct ring *ring, const void *element)
+{
+  unsigned int tail
+      = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+
+  // indexes wrap around, but their difference is still the count
+  int spins = 0;
+  while (tail - ring->head_seen == ring->capacity)
+    {
+      ring->head_seen
+          = atomic_load_explicit (&ring->head, memory_order_acquire);
+      if (tail - ring->head_seen == ring->capacity)
+        ring_wait (&spins);
+    }
+
+  memcpy (ring->data + (tail & ring->mask) * ring->size, element, ring->size);
+
+  // the element has to be there before the consumer sees the new tail
+  atomic_store_explicit (&ring->tail, tail + 1, memory_order_release);
+}
+
+_Bool
+ring_pop (struct ring *ring, void *element)
+{
+  unsigned int head
+      = atomic_load_explicit (&ring->head, memory_order_relaxed);
+
+  int spins = 0;
+  while (head == ring->tail_seen)
+    {
+      // `closed' is set after the last push, so if it's set and the ring is
+      // still empty there's nothing else coming
+      _Bool closed
+          = atomic_load_explicit (&ring->closed, memory_order_acquire);
+      ring->tail_seen
+          = atomic_load_explicit (&ring->tail, memory_order_acquire);
+      if (head != ring->tail_seen)
+        break;
+
+      if (closed)
+        return 0;
+
+      ring_wait (&spins);
+    }
+
+  memcpy (element, ring->data + (head & ring->mask) * ring->size, ring->size);
+
+  // the element has to be copied before the producer can overwrite it
+  atomic_store_explicit (&ring->head, head + 1, memory_order_release);
+  return 1;
+}
+
+void
+ring_close (struct ring *ring)
+{
+  atomic_store_explicit (&ring->closed, 1, memory_order_release);
+}
@@ -0,0 +1,63 @@
+#ifndef __RING_H
+#define __RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Both ends of a ring are kept on their own cache line, so the two threads
+// don't keep stealing it from each other
+#define RING_CACHE_LINE 64
+
+// Times a waiting side checks the ring again before letting other threads
+// run
+#define RING_SPINS 128
+
+/**
+ * A bounded queue between two threads, one that only pushes and one that
+ * only pops, which doesn't take any lock. Elements are copied in and out.
+ * Pushing into a full ring waits for the consumer to make room, so it never
+ * holds more than `capacity' elements however far ahead the producer is.
+ */
+struct ring
+{
+  char *data;
+  size_t size;
+
+  // Always a power of two
+  unsigned int capacity;
+  unsigned int mask;
+
+  // Next element to pop, only written by the consumer. It keeps the last
+  // `tail' it saw and only reads it again once it has caught up with it
+  _Alignas (RING_CACHE_LINE) atomic_uint head;
+  unsigned int tail_seen;
+
+  // Next element to push, only written by the producer
+  _Alignas (RING_CACHE_LINE) atomic_uint tail;
+  unsigned int head_seen;
+  atomic_bool closed;
+};
+
+/**
+ * Creates a ring of `capacity' (a power of two) elements of `size' bytes
+ */
+struct ring *ring_create (size_t size, unsigned int capacity);
+void ring_free (struct ring *ring);
+
+/**
+ * Copies `element' to the end of the ring, waiting for room if it's full
+ */
+void ring_push (struct ring *ring, const void *element);
+
+/**
+ * Moves the first element of the ring to `element', waiting for one if it's
+ * empty. Returns 0 once the ring is closed and there's nothing left
+ */
+_Bool ring_pop (struct ring *ring, void *element);
+
+/**
+ * Tells the consumer nothing else will be pushed
+ */
+void ring_close (struct ring *ring);
+
+#endif
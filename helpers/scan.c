@@ -0,0 +1,275 @@
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+static _Bool
+scan_is_identifier_char (char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+         || (c >= '0' && c <= '9') || c == '_';
+}
+
+static size_t
+scan_identifier_scalar (const char *str, size_t len)
+{
+  size_t i = 0;
+  while (i < len && scan_is_identifier_char (str[i]))
+    i++;
+
+  return i;
+}
+
+static size_t
+scan_blanks_scalar (const char *str, size_t len)
+{
+  size_t i = 0;
+  while (i < len && (str[i] == ' ' || str[i] == '\t'))
+    i++;
+
+  return i;
+}
+
+static size_t
+scan_line_scalar (const char *str, size_t len)
+{
+  size_t i = 0;
+  while (i < len && str[i] != '\n')
+    i++;
+
+  return i;
+}
+
+static size_t
+scan_comment_end_scalar (const char *str, size_t len)
+{
+  for (size_t i = 0; i + 1 < len; i++)
+    {
+      if (str[i] == '*' && str[i + 1] == '/')
+        return i;
+    }
+
+  return len;
+}
+
+#ifdef SCAN_X86
+
+// bytes of `v' in [lo, hi]. There are no unsigned byte compares, so the range
+// is moved to the bottom of the signed range and compared there
+__attribute__ ((target ("sse2"))) static __m128i
+scan_in_range_sse2 (__m128i v, char lo, char hi)
+{
+  __m128i biased = _mm_add_epi8 (v, _mm_set1_epi8 ((char)(0x80 - lo)));
+  return _mm_cmplt_epi8 (biased, _mm_set1_epi8 ((char)(0x80 + hi - lo + 1)));
+}
+
+__attribute__ ((target ("sse2"))) static size_t
+scan_identifier_sse2 (const char *str, size_t len)
+{
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *)(str + i));
+      // or'ing 0x20 turns upper case letters into lower case ones
+      __m128i alpha
+          = scan_in_range_sse2 (_mm_or_si128 (v, _mm_set1_epi8 (0x20)), 'a',
+                                'z');
+      __m128i digit = scan_in_range_sse2 (v, '0', '9');
+      __m128i under = _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('_'));
+      int mask = _mm_movemask_epi8 (
+          _mm_or_si128 (_mm_or_si128 (alpha, digit), under));
+      if (mask != 0xffff)
+        return i + __builtin_ctz (~mask);
+    }
+
+  return i + scan_identifier_scalar (str + i, len - i);
+}
+
+__attribute__ ((target ("sse2"))) static size_t
+scan_blanks_sse2 (const char *str, size_t len)
+{
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *)(str + i));
+      int mask = _mm_movemask_epi8 (
+          _mm_or_si128 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 (' ')),
+                        _mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\t'))));
+      if (mask != 0xffff)
+        return i + __builtin_ctz (~mask);
+    }
+
+  return i + scan_blanks_scalar (str + i, len - i);
+}
+
+__attribute__ ((target ("sse2"))) static size_t
+scan_line_sse2 (const char *str, size_t len)
+{
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *)(str + i));
+      int mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ('\n')));
+      if (mask)
+        return i + __builtin_ctz (mask);
+    }
+
+  return i + scan_line_scalar (str + i, len - i);
+}
+
+__attribute__ ((target ("sse2"))) static size_t
+scan_comment_end_sse2 (const char *str, size_t len)
+{
+  size_t i = 0;
+  // the second load reads one byte ahead
+  for (; i + 17 <= len; i += 16)
+    {
+      __m128i star = _mm_loadu_si128 ((const __m128i *)(str + i));
+      __m128i slash = _mm_loadu_si128 ((const __m128i *)(str + i + 1));
+      int mask = _mm_movemask_epi8 (
+          _mm_and_si128 (_mm_cmpeq_epi8 (star, _mm_set1_epi8 ('*')),
+                         _mm_cmpeq_epi8 (slash, _mm_set1_epi8 ('/'))));
+      if (mask)
+        return i + __builtin_ctz (mask);
+    }
+
+  return i + scan_comment_end_scalar (str + i, len - i);
+}
+
+__attribute__ ((target ("avx2"))) static __m256i
+scan_in_range_avx2 (__m256i v, char lo, char hi)
+{
+  __m256i biased = _mm256_add_epi8 (v, _mm256_set1_epi8 ((char)(0x80 - lo)));
+  return _mm256_cmpgt_epi8 (_mm256_set1_epi8 ((char)(0x80 + hi - lo + 1)),
+                            biased);
+}
+
+__attribute__ ((target ("avx2"))) static size_t
+scan_identifier_avx2 (const char *str, size_t len)
+{
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *)(str + i));
+      __m256i alpha = scan_in_range_avx2 (
+          _mm256_or_si256 (v, _mm256_set1_epi8 (0x20)), 'a', 'z');
+      __m256i digit = scan_in_range_avx2 (v, '0', '9');
+      __m256i under = _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('_'));
+      unsigned int mask = _mm256_movemask_epi8 (
+          _mm256_or_si256 (_mm256_or_si256 (alpha, digit), under));
+      if (mask != 0xffffffff)
+        return i + __builtin_ctz (~mask);
+    }
+
+  return i + scan_identifier_sse2 (str + i, len - i);
+}
+
+__attribute__ ((target ("avx2"))) static size_t
+scan_blanks_avx2 (const char *str, size_t len)
+{
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *)(str + i));
+      unsigned int mask = _mm256_movemask_epi8 (
+          _mm256_or_si256 (_mm256_cmpeq_epi8 (v, _mm256_set1_epi8 (' ')),
+                           _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('\t'))));
+      if (mask != 0xffffffff)
+        return i + __builtin_ctz (~mask);
+    }
+
+  return i + scan_blanks_sse2 (str + i, len - i);
+}
+
+__attribute__ ((target ("avx2"))) static size_t
+scan_line_avx2 (const char *str, size_t len)
+{
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *)(str + i));
+      unsigned int mask = _mm256_movemask_epi8 (
+          _mm256_cmpeq_epi8 (v, _mm256_set1_epi8 ('\n')));
+      if (mask)
+        return i + __builtin_ctz (mask);
+    }
+
+  return i + scan_line_sse2 (str + i, len - i);
+}
+
+__attribute__ ((target ("avx2"))) static size_t
+scan_comment_end_avx2 (const char *str, size_t len)
+{
+  size_t i = 0;
+  for (; i + 33 <= len; i += 32)
+    {
+      __m256i star = _mm256_loadu_si256 ((const __m256i *)(str + i));
+      __m256i slash = _mm256_loadu_si256 ((const __m256i *)(str + i + 1));
+      __m256i is_star = _mm256_cmpeq_epi8 (star, _mm256_set1_epi8 ('*'));
+      __m256i is_slash = _mm256_cmpeq_epi8 (slash, _mm256_set1_epi8 ('/'));
+      unsigned int mask
+          = _mm256_movemask_epi8 (_mm256_and_si256 (is_star, is_slash));
+      if (mask)
+        return i + __builtin_ctz (mask);
+    }
+
+  return i + scan_comment_end_sse2 (str + i, len - i);
+}
+
+#endif
+
+static size_t (*scan_identifier_impl) (const char *, size_t)
+    = scan_identifier_scalar;
+static size_t (*scan_blanks_impl) (const char *, size_t) = scan_blanks_scalar;
+static size_t (*scan_line_impl) (const char *, size_t) = scan_line_scalar;
+static size_t (*scan_comment_end_impl) (const char *, size_t)
+    = scan_comment_end_scalar;
+
+// picks the widest implementation the CPU can run, once, before main
+__attribute__ ((constructor)) static void
+scan_select_implementation ()
+{
+#ifdef SCAN_X86
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2"))
+    {
+      scan_identifier_impl = scan_identifier_avx2;
+      scan_blanks_impl = scan_blanks_avx2;
+      scan_line_impl = scan_line_avx2;
+      scan_comment_end_impl = scan_comment_end_avx2;
+    }
+  else if (__builtin_cpu_supports ("sse2"))
+    {
+      scan_identifier_impl = scan_identifier_sse2;
+      scan_blanks_impl = scan_blanks_sse2;
+      scan_line_impl = scan_line_sse2;
+      scan_comment_end_impl = scan_comment_end_sse2;
+    }
+#endif
+}
+
+size_t
+scan_identifier (const char *str, size_t len)
+{
+  return scan_identifier_impl (str, len);
+}
+
+size_t
+scan_blanks (const char *str, size_t len)
+{
+  return scan_blanks_impl (str, len);
+}
+
+size_t
+scan_line (const char *str, size_t len)
+{
+  return scan_line_impl (str, len);
+}
+
+size_t
+scan_comment_end (const char *str, size_t len)
+{
+  return scan_comment_end_impl (str, len);
+}
@@ -0,0 +1,32 @@
+#ifndef __SCAN_H
+#define __SCAN_H
+
+#include <stddef.h>
+
+/**
+ * Vectorized scanning of in-memory text. SSE2 is used on every x86 CPU and
+ * AVX2 when the CPU we are running on has it, other machines get the plain
+ * loops. All of them read at most `len' bytes from `str'.
+ */
+
+/**
+ * Length of the run of [A-Za-z0-9_] at the start of `str'
+ */
+size_t scan_identifier (const char *str, size_t len);
+
+/**
+ * Length of the run of spaces and tabs at the start of `str'
+ */
+size_t scan_blanks (const char *str, size_t len);
+
+/**
+ * Offset of the first newline in `str', `len' if there's none
+ */
+size_t scan_line (const char *str, size_t len);
+
+/**
+ * Offset of the first "*" "/" pair in `str', `len' if there's none
+ */
+size_t scan_comment_end (const char *str, size_t len);
+
+#endif
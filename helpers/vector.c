@@ -51,29 +51,30 @@ vector_element_size (struct vector *vector)
 struct vector *
 vector_clone (struct vector *vector)
 {
-  void *new_data_address
-      = calloc (vector->esize, vector->count + VECTOR_ELEMENT_INCREMENT);
+  void *new_data_address = calloc (vector->esize, vector->mindex);
   memcpy (new_data_address, vector->data, vector_total_size (vector));
   struct vector *new_vec = calloc (sizeof (struct vector), 1);
   memcpy (new_vec, vector, sizeof (struct vector));
   new_vec->data = new_data_address;
 
   // Saves are not cloned with vector_clone yet.
-  // assert(vector->saves == NULL);
+  new_vec->saves = NULL;
   return new_vec;
 }
 
 struct vector *
 vector_create (size_t esize)
 {
-  struct vector *vec = vector_create_no_saves (esize);
-  vec->saves = vector_create_no_saves (sizeof (struct vector));
-  return vec;
+  // Saves are only made once vector_save is called, most vectors never are
+  return vector_create_no_saves (esize);
 }
 
 void
 vector_free (struct vector *vector)
 {
+  if (vector->saves)
+    vector_free (vector->saves);
+
   free (vector->data);
   free (vector);
 }
@@ -84,21 +85,45 @@ vector_current_index (struct vector *vector)
   return vector->rindex;
 }
 
+static void
+vector_set_capacity (struct vector *vector, int capacity)
+{
+  vector->data = realloc (vector->data, capacity * vector->esize);
+  assert (vector->data);
+  vector->mindex = capacity;
+}
+
 void
-vector_resize_for_index (struct vector *vector, int start_index,
-                         int total_elements)
+vector_reserve (struct vector *vector, int total_elements)
 {
-  if (start_index + total_elements < vector->mindex)
+  if (total_elements <= vector->mindex)
     {
       // Nothing to resize
       return;
     }
 
-  vector->data = realloc (
-      vector->data, ((start_index + total_elements + VECTOR_ELEMENT_INCREMENT)
-                     * vector->esize));
-  assert (vector->data);
-  vector->mindex = start_index + total_elements;
+  // Doubling keeps pushing N elements O(N) overall
+  int capacity = vector->mindex * 2;
+  if (capacity < total_elements)
+    capacity = total_elements;
+
+  vector_set_capacity (vector, capacity);
+}
+
+void
+vector_shrink_to_fit (struct vector *vector)
+{
+  // Always keep room for one element, realloc to 0 bytes may free
+  int capacity = vector->count > 0 ? vector->count : 1;
+  if (capacity < vector->mindex)
+    vector_set_capacity (vector, capacity);
+}
+
+void
+vector_resize_for_index (struct vector *vector, int start_index,
+                         int total_elements)
+{
+  vector_reserve (vector, start_index + total_elements);
 }
 
 void
@@ -235,6 +260,9 @@ vector_back_ptr (struct vector *vector)
 void
 vector_save (struct vector *vector)
 {
+  if (!vector->saves)
+    vector->saves = vector_create_no_saves (sizeof (struct vector));
+
   // Let's save the state of this vector to its self
   struct vector tmp_vec = *vector;
   // We not allowed to modify the saves so set it to NULL
@@ -246,15 +274,21 @@ vector_save (struct vector *vector)
 void
 vector_restore (struct vector *vector)
 {
+  assert (vector->saves);
   struct vector save_vec = *((struct vector *)(vector_back (vector->saves)));
-  save_vec.saves = vector->saves;
-  *vector = save_vec;
+
+  // The data may have moved since the save, only the indexes go back
+  vector->pindex = save_vec.pindex;
+  vector->rindex = save_vec.rindex;
+  vector->count = save_vec.count;
+  vector->flags = save_vec.flags;
   vector_pop (vector->saves);
 }
 
 void
 vector_save_purge (struct vector *vector)
 {
+  assert (vector->saves);
   vector_pop (vector->saves);
 }
 
@@ -268,16 +302,26 @@ vector_pop_last_peek (struct vector *vector)
 void
 vector_push (struct vector *vector, void *elem)
 {
+  if (vector->rindex >= vector->mindex)
+    {
+      vector_reserve (vector, vector->rindex + 1);
+    }
+
   void *ptr = vector_at (vector, vector->rindex);
   memcpy (ptr, elem, vector->esize);
 
   vector->rindex++;
   vector->count++;
+}
 
-  if (vector->rindex >= vector->mindex)
-    {
-      vector_resize (vector);
-    }
+void
+vector_push_multiple (struct vector *vector, const void *elems, int total)
+{
+  vector_reserve (vector, vector->rindex + total);
+  memcpy (vector_at (vector, vector->rindex), elems, total * vector->esize);
+
+  vector->rindex += total;
+  vector->count += total;
 }
 
 int
@@ -321,12 +365,13 @@ void
 vector_shift_right_in_bounds_no_increment (struct vector *vector, int index,
                                            int amount)
 {
-  vector_resize_for_index (vector, index, amount);
+  // Everything from `index' on ends up `amount' elements further
+  vector_resize_for_index (vector, vector->count, amount);
   int eindex = (index + amount);
   size_t bytes_to_move
       = vector_elements_until_end (vector, index) * vector->esize;
-  memcpy (vector_at (vector, eindex), vector_at (vector, index),
-          bytes_to_move);
+  memmove (vector_at (vector, eindex), vector_at (vector, index),
+           bytes_to_move);
   memset (vector_at (vector, index), 0x00, amount * vector->esize);
 }
 
@@ -400,7 +445,7 @@ vector_pop_at (struct vector *vector, int index)
   void *next_element_pos = dst_pos + vector->esize;
   void *end_pos = vector_data_end (vector);
   size_t total = (size_t)end_pos - (size_t)next_element_pos;
-  memcpy (dst_pos, next_element_pos, total);
+  memmove (dst_pos, next_element_pos, total);
   vector->count -= 1;
   vector->rindex -= 1;
 }
@@ -476,10 +521,16 @@ vector_empty (struct vector *vector)
 void
 vector_clear (struct vector *vector)
 {
-  while (vector_count (vector))
-    {
-      vector_pop (vector);
-    }
+  vector->rindex = 0;
+  vector->count = 0;
+}
+
+void
+vector_truncate (struct vector *vector, int count)
+{
+  assert (count >= 0 && count <= vector->count);
+  vector->rindex = count;
+  vector->count = count;
 }
 
 void *
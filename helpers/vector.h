@@ -4,8 +4,8 @@
 #include <stddef.h>
 #include <stdio.h>
 
-// We want at least 20 vector element spaces in reserve before having
-// to reallocate memory again
+// Vectors start with room for this many elements, and double it every time
+// they run out
 #define VECTOR_ELEMENT_INCREMENT 20
 
 enum
@@ -20,6 +20,7 @@ struct vector
   // "vector_peek". This index will then be incremented
   int pindex;
   int rindex;
+  // How many elements fit in `data'
   int mindex;
   int count;
   int flags;
@@ -29,6 +30,7 @@ struct vector
   // internal state at all times with vector_save Data is not restored and is
   // permenant, save does not respect data, only pointers and variables are
   // saved. Useful to temporarily push the vector state and restore it later.
+  // NULL until the first save.
   struct vector *saves;
 };
 
@@ -56,6 +58,12 @@ void *vector_peek_ptr (struct vector *vector);
 void vector_set_peek_pointer (struct vector *vector, int index);
 void vector_set_peek_pointer_end (struct vector *vector);
 void vector_push (struct vector *vector, void *elem);
+
+/**
+ * Pushes `total' elements stored one after the other at `elems'
+ */
+void vector_push_multiple (struct vector *vector, const void *elems,
+                           int total);
 void vector_push_at (struct vector *vector, int index, void *ptr);
 void vector_pop (struct vector *vector);
 void vector_peek_pop (struct vector *vector);
@@ -77,6 +85,22 @@ const char *vector_string (struct vector *vec);
 _Bool vector_empty (struct vector *vector);
 void vector_clear (struct vector *vector);
 
+/**
+ * Drops every element past the first `count', like popping them one by one
+ */
+void vector_truncate (struct vector *vector, int count);
+
+/**
+ * Makes sure `total_elements' fit without reallocating. Pointers into the
+ * vector are invalidated if it has to grow
+ */
+void vector_reserve (struct vector *vector, int total_elements);
+
+/**
+ * Gives back the memory that isn't being used by any element
+ */
+void vector_shrink_to_fit (struct vector *vector);
+
 int vector_count (struct vector *vector);
 /**
  * freads from the file directly into the vector
@@ -0,0 +1,158 @@
+/*
+ * keyword.c - Classifies keywords through a perfect hash, so we never have to
+ * compare a word against every keyword.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include "compiler.h"
+
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 18
+#define KEYWORD_MAX_HASH_VALUE 48
+
+#define KEYWORD_PRIMITIVE_FLAGS                                               \
+  (KEYWORD_FLAG_DATATYPE | KEYWORD_FLAG_PRIMITIVE)
+
+struct keyword
+{
+  const char *name;
+  int flags;
+};
+
+static const struct keyword keywords[KEYWORD_TOTAL] = {
+    [KEYWORD_UNSIGNED] = { "unsigned", KEYWORD_FLAG_VARIABLE_MODIFIER },
+    [KEYWORD_SIGNED] = { "signed", KEYWORD_FLAG_VARIABLE_MODIFIER },
+    [KEYWORD_CHAR] = { "char", KEYWORD_PRIMITIVE_FLAGS },
+    [KEYWORD_SHORT] = { "short", KEYWORD_PRIMITIVE_FLAGS },
+    [KEYWORD_INT] = { "int", KEYWORD_PRIMITIVE_FLAGS },
+    [KEYWORD_LONG] = { "long", KEYWORD_PRIMITIVE_FLAGS },
+    [KEYWORD_FLOAT] = { "float", KEYWORD_PRIMITIVE_FLAGS },
+    [KEYWORD_DOUBLE] = { "double", KEYWORD_PRIMITIVE_FLAGS },
+    [KEYWORD_VOID] = { "void", KEYWORD_PRIMITIVE_FLAGS },
+    [KEYWORD_STRUCT] = { "struct", KEYWORD_FLAG_DATATYPE },
+    [KEYWORD_UNION] = { "union", KEYWORD_FLAG_DATATYPE },
+    [KEYWORD_STATIC] = { "static", KEYWORD_FLAG_VARIABLE_MODIFIER },
+    [KEYWORD_IGNORE_TYPECHECK]
+    = { "__ignore_typecheck", KEYWORD_FLAG_VARIABLE_MODIFIER },
+    [KEYWORD_RETURN] = { "return", 0 },
+    [KEYWORD_INCLUDE] = { "include", 0 },
+    [KEYWORD_SIZEOF] = { "sizeof", 0 },
+    [KEYWORD_IF] = { "if", 0 },
+    [KEYWORD_ELSE] = { "else", 0 },
+    [KEYWORD_WHILE] = { "while", 0 },
+    [KEYWORD_FOR] = { "for", 0 },
+    [KEYWORD_DO] = { "do", 0 },
+    [KEYWORD_BREAK] = { "break", 0 },
+    [KEYWORD_CONTINUE] = { "continue", 0 },
+    [KEYWORD_SWITCH] = { "switch", 0 },
+    [KEYWORD_CASE] = { "case", 0 },
+    [KEYWORD_DEFAULT] = { "default", 0 },
+    [KEYWORD_GOTO] = { "goto", 0 },
+    [KEYWORD_TYPEDEF] = { "typedef", 0 },
+    [KEYWORD_CONST] = { "const", KEYWORD_FLAG_VARIABLE_MODIFIER },
+    [KEYWORD_EXTERN] = { "extern", KEYWORD_FLAG_VARIABLE_MODIFIER },
+    [KEYWORD_RESTRICT] = { "restrict", 0 },
+};
+
+// gperf-style association values: hash = len + asso[first] + asso[last].
+// They're chosen so no two keywords share a hash; `make bench' looks every
+// keyword up by its name (bench/keywords.c) and fails if one got a shared or
+// missing slot. Update KEYWORD_MAX_HASH_VALUE if you add one.
+static const unsigned char keyword_asso_values[256] = {
+    ['b'] = 7, ['c'] = 14, ['d'] = 19, ['e'] = 7, ['f'] = 10, ['g'] = 4,
+    ['i'] = 5, ['k'] = 2, ['l'] = 5, ['n'] = 2, ['o'] = 2, ['r'] = 3,
+    ['s'] = 18, ['t'] = 22, ['v'] = 12,
+};
+
+// hash -> keyword, empty slots are KEYWORD_NONE
+static const unsigned char keyword_hash_table[KEYWORD_MAX_HASH_VALUE + 1] = {
+    [7] = KEYWORD_UNION,
+    [10] = KEYWORD_GOTO,
+    [11] = KEYWORD_RETURN,
+    [12] = KEYWORD_WHILE,
+    [13] = KEYWORD_LONG,
+    [14] = KEYWORD_BREAK,
+    [15] = KEYWORD_EXTERN,
+    [16] = KEYWORD_FOR,
+    [17] = KEYWORD_IF,
+    [18] = KEYWORD_ELSE,
+    [19] = KEYWORD_INCLUDE,
+    [20] = KEYWORD_IGNORE_TYPECHECK,
+    [21] = KEYWORD_CHAR,
+    [23] = KEYWORD_DO,
+    [24] = KEYWORD_SWITCH,
+    [25] = KEYWORD_CASE,
+    [27] = KEYWORD_UNSIGNED,
+    [29] = KEYWORD_CONTINUE,
+    [30] = KEYWORD_INT,
+    [32] = KEYWORD_DOUBLE,
+    [33] = KEYWORD_RESTRICT,
+    [34] = KEYWORD_SIZEOF,
+    [35] = KEYWORD_VOID,
+    [37] = KEYWORD_FLOAT,
+    [38] = KEYWORD_STATIC,
+    [39] = KEYWORD_TYPEDEF,
+    [41] = KEYWORD_CONST,
+    [43] = KEYWORD_SIGNED,
+    [45] = KEYWORD_SHORT,
+    [46] = KEYWORD_STRUCT,
+    [48] = KEYWORD_DEFAULT,
+};
+
+static unsigned int
+keyword_hash (const char *str, size_t len)
+{
+  return len + keyword_asso_values[(unsigned char)str[0]]
+         + keyword_asso_values[(unsigned char)str[len - 1]];
+}
+
+int
+keyword_lookup (const char *str, size_t len)
+{
+  if (len < KEYWORD_MIN_LENGTH || len > KEYWORD_MAX_LENGTH)
+    return KEYWORD_NONE;
+
+  unsigned int hash = keyword_hash (str, len);
+  if (hash > KEYWORD_MAX_HASH_VALUE)
+    return KEYWORD_NONE;
+
+  int keyword = keyword_hash_table[hash];
+  const char *name = keywords[keyword].name;
+  if (keyword == KEYWORD_NONE || strncmp (name, str, len) != 0
+      || name[len] != 0x00)
+    return KEYWORD_NONE;
+
+  return keyword;
+}
+
+const char *
+keyword_name (int keyword)
+{
+  return keywords[keyword].name;
+}
+
+static _Bool
+keyword_has_flag (int keyword, int flag)
+{
+  return keyword > KEYWORD_NONE && keyword < KEYWORD_TOTAL
+         && (keywords[keyword].flags & flag);
+}
+
+_Bool
+keyword_is_datatype (int keyword)
+{
+  return keyword_has_flag (keyword, KEYWORD_FLAG_DATATYPE);
+}
+
+_Bool
+keyword_is_primitive (int keyword)
+{
+  return keyword_has_flag (keyword, KEYWORD_FLAG_PRIMITIVE);
+}
+
+_Bool
+keyword_is_variable_modifier (int keyword)
+{
+  return keyword_has_flag (keyword, KEYWORD_FLAG_VARIABLE_MODIFIER);
+}
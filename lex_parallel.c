@@ -0,0 +1,263 @@
+/*
+ * lex_parallel.c - Lexes a large input on several threads and stitches the
+ * tokens together.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include "compiler.h"
+#include "helpers/pool.h"
+#include "helpers/vector.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// inputs are only split in chunks of at least this many bytes, smaller ones
+// aren't worth a thread
+#define LEX_PARALLEL_MIN_CHUNK (1 << 20)
+
+// chunks for every thread, so the ones that finish early can take some from
+// the rest
+#define LEX_PARALLEL_CHUNKS_PER_THREAD 4
+
+struct lex_chunk
+{
+  // the lexer starts at `start' and stops at the first token that ends at
+  // or after `end'
+  unsigned int start;
+  unsigned int end;
+
+  struct compile_process compiler;
+  struct lex_process *lexer;
+  char *diagnostics;
+  size_t diagnostics_len;
+
+  // the lexer gave up on an error, or the input was over before `end'
+  _Bool failed;
+  _Bool over;
+};
+
+// the first offset at or after `from' where a line starts that a lexer can
+// start at as if it had read everything before it, `size' if there's none.
+// The line can't start with anything that looks at the token before it:
+// whitespace and trivia mark it, and `<' might be part of an include. It
+// could still be in the middle of a comment or a string, that's only known
+// once the chunk before it is lexed
+static unsigned int
+lex_parallel_split (const char *data, size_t size, size_t from)
+{
+  if (from >= size)
+    return size;
+
+  const char *newline = memchr (data + from - 1, '\n', size - (from - 1));
+  while (newline)
+    {
+      size_t offset = newline + 1 - data;
+      if (offset >= size)
+        break;
+
+      // strchr finds the terminator as well, so no line starts with a null
+      // character either
+      if (!strchr (" \t\n/\\<", data[offset]))
+        return offset;
+
+      newline = memchr (newline + 1, '\n', size - offset);
+    }
+
+  return size;
+}
+
+static _Bool
+lex_chunk_create (struct lex_chunk *chunk, struct lex_process *process)
+{
+  compile_process_copy (&chunk->compiler, process->compiler);
+  chunk->compiler.diagnostics
+      = open_memstream (&chunk->diagnostics, &chunk->diagnostics_len);
+  chunk->lexer
+      = lex_process_create (&chunk->compiler, process->function, NULL);
+  chunk->lexer->flags = process->flags | LEX_PROCESS_FLAG_NO_BRACKETS;
+  return chunk->compiler.diagnostics != NULL;
+}
+
+static void
+lex_chunk_destroy (struct lex_chunk *chunk)
+{
+  if (!chunk->lexer)
+    return;
+
+  if (chunk->compiler.diagnostics)
+    fclose (chunk->compiler.diagnostics);
+
+  lex_process_free (chunk->lexer);
+  compile_process_free_copy (&chunk->compiler);
+  free (chunk->diagnostics);
+  chunk->lexer = NULL;
+}
+
+// lexes until the first token that ends at or after `end', unless the lexer
+// fails or the input is over first
+static void
+lex_chunk_run (struct lex_chunk *chunk, unsigned int end)
+{
+  jmp_buf error_jmp;
+  chunk->compiler.error_jmp = &error_jmp;
+  if (setjmp (error_jmp))
+    {
+      chunk->failed = 1;
+      return;
+    }
+
+  while (chunk->lexer->offset < end)
+    {
+      if (!lex_next (chunk->lexer))
+        {
+          chunk->over = 1;
+          return;
+        }
+    }
+}
+
+static void
+lex_parallel_job (int job, void *private)
+{
+  struct lex_chunk *chunk = (struct lex_chunk *)private + job;
+
+  // tokens left in the input point into it from the very beginning, like
+  // the ones of every other chunk
+  lex_begin (chunk->lexer);
+  chunk->compiler.cfile.offset = chunk->start;
+  chunk->lexer->offset = chunk->start;
+  lex_chunk_run (chunk, chunk->end);
+}
+
+// moves the tokens of `chunk' to the end of `process'. Their brackets are
+// matched first, so if there's an error nothing is moved
+static void
+lex_parallel_append (struct lex_process *process, struct lex_chunk *chunk)
+{
+  struct token_stream *tokens = chunk->lexer->tokens;
+  int count = vector_count (tokens->brackets);
+  for (int i = 0; i < count; i++)
+    lex_follow_brackets (process, vector_at (tokens->brackets, i));
+
+  token_stream_append (process->tokens, tokens);
+}
+
+// puts the tokens of every chunk together, in order. The lexer that read up
+// to where a chunk starts must have stopped right there, otherwise the chunk
+// started in the middle of a token and its tokens are thrown away: that
+// lexer goes on to the end of the chunk instead
+static void
+lex_parallel_stitch (struct lex_process *process, struct lex_chunk *chunks,
+                     int total)
+{
+  struct lex_chunk *current = &chunks[0];
+  for (int i = 1; i < total && !current->failed && !current->over; i++)
+    {
+      struct lex_chunk *next = &chunks[i];
+      if (current->lexer->offset != next->start)
+        {
+          lex_chunk_destroy (next);
+          lex_chunk_run (current, next->end);
+          continue;
+        }
+
+      lex_parallel_append (process, current);
+      lex_chunk_destroy (current);
+      current = next;
+    }
+
+  // whatever the failed lexer read before the error is still there, the
+  // same as if it had read it all
+  lex_parallel_append (process, current);
+  if (current->failed)
+    {
+      fflush (current->compiler.diagnostics);
+      compiler_fail (process->compiler, current->diagnostics,
+                     current->diagnostics_len);
+    }
+
+  process->offset = current->lexer->offset;
+  process->compiler->cfile.offset = current->lexer->offset;
+}
+
+int
+lex_parallel (struct lex_process *process, int threads)
+{
+  struct compile_process *compiler = process->compiler;
+  const char *data = compiler->cfile.data;
+  size_t size = compiler->cfile.size;
+
+  // chunks read the input on their own, it has to be in memory
+  int total = 0;
+  if (data && threads > 1)
+    {
+      total = threads * LEX_PARALLEL_CHUNKS_PER_THREAD;
+      if ((size_t)total > size / LEX_PARALLEL_MIN_CHUNK)
+        total = size / LEX_PARALLEL_MIN_CHUNK;
+    }
+
+  struct lex_chunk *chunks
+      = calloc (total ? total : 1, sizeof (struct lex_chunk));
+  unsigned int start = 0;
+  int count = 0;
+  while (count < total && start < size)
+    {
+      size_t target = size / total * (count + 1);
+      unsigned int end = count == total - 1
+                             ? size
+                             : lex_parallel_split (data, size,
+                                                   target > start ? target
+                                                                  : start + 1);
+
+      chunks[count].start = start;
+      chunks[count].end = end;
+      start = end;
+      count++;
+    }
+
+  _Bool ready = count > 1;
+  for (int i = 0; ready && i < count; i++)
+    ready = lex_chunk_create (&chunks[i], process);
+
+  if (!ready)
+    {
+      for (int i = 0; i < count; i++)
+        lex_chunk_destroy (&chunks[i]);
+
+      free (chunks);
+      return lex (process);
+    }
+
+  lex_begin (process);
+  pool_run (threads, count, lex_parallel_job, chunks);
+
+  // errors while stitching still give up on the file, but the chunks have
+  // to go first
+  jmp_buf *error_jmp = compiler->error_jmp;
+  jmp_buf stitch_jmp;
+  compiler->error_jmp = &stitch_jmp;
+  _Bool failed = 0;
+  if (!setjmp (stitch_jmp))
+    lex_parallel_stitch (process, chunks, count);
+  else
+    failed = 1;
+
+  compiler->error_jmp = error_jmp;
+  for (int i = 0; i < count; i++)
+    lex_chunk_destroy (&chunks[i]);
+
+  free (chunks);
+  if (failed)
+    {
+      if (error_jmp)
+        longjmp (*error_jmp, 1);
+
+      exit (-1);
+    }
+
+  // the end of the input is read once more, so brackets that were never
+  // closed take the rest of it
+  lex_next (process);
+  return LEXICAL_ANALYSIS_ALL_OK;
+}
@@ -6,6 +6,7 @@
 
 #include "compiler.h"
 
+#include "helpers/buffer.h"
 #include "helpers/vector.h"
 #include <stdlib.h>
 
@@ -15,18 +16,18 @@ lex_process_create (struct compile_process *compiler,
 {
   struct lex_process *process = calloc (1, sizeof (struct lex_process));
   process->function = functions;
-  process->token_vec = vector_create (sizeof (struct token));
+  process->tokens = token_stream_create (compiler->strings);
+  process->token_buffer = buffer_create ();
   process->compiler = compiler;
   process->private = private;
-  process->pos.line = 1;
-  process->pos.col = 1;
   return process;
 }
 
 void
 lex_process_free (struct lex_process *process)
 {
-  vector_free (process->token_vec);
+  token_stream_free (process->tokens);
+  buffer_free (process->token_buffer);
   free (process);
 }
 
@@ -36,8 +37,8 @@ lex_process_private (struct lex_process *process)
   return process->private;
 }
 
-struct vector *
+struct token_stream *
 lex_process_tokens (struct lex_process *process)
 {
-  return process->token_vec;
+  return process->tokens;
 }
@@ -0,0 +1,180 @@
+/*
+ * lex_thread.c - Lexes a file on a thread of its own while it's parsed.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include "compiler.h"
+#include "helpers/ring.h"
+#include "helpers/vector.h"
+
+#include <stdlib.h>
+
+// how many tokens the lexer can get ahead of the parser, must be a power of
+// two
+#define LEX_THREAD_RING_SIZE 4096
+
+// what goes through the ring: a token, or a pair of brackets the lexer
+// found
+struct lex_thread_item
+{
+  _Bool is_brackets;
+  union
+  {
+    struct token_stream_entry token;
+    struct token_brackets brackets;
+  };
+};
+
+// sends the tokens the lexer won't touch anymore, that's every one but the
+// last unless the input is over (it might still get whitespace after it)
+static void
+lex_thread_send (struct lex_thread *lex_thread, _Bool more)
+{
+  struct token_stream *tokens = lex_thread->lexer->tokens;
+  struct lex_thread_item item = { 0 };
+
+  // `cursor' is the first token not sent, the ones before it are recycled
+  int end = more ? token_stream_last (tokens) : tokens->count;
+  while (tokens->cursor < end)
+    {
+      item.is_brackets = 0;
+      token_stream_take (tokens, tokens->cursor++, &item.token);
+      ring_push (lex_thread->ring, &item);
+    }
+
+  int count = vector_count (tokens->brackets);
+  for (int i = tokens->brackets_base; i < count; i++)
+    {
+      struct token_brackets *brackets = vector_at (tokens->brackets, i);
+      item.is_brackets = 1;
+      item.brackets = *brackets;
+      ring_push (lex_thread->ring, &item);
+    }
+
+  vector_clear (tokens->brackets);
+  tokens->brackets_base = 0;
+}
+
+static void *
+lex_thread_main (void *arg)
+{
+  struct lex_thread *lex_thread = arg;
+  struct lex_process *lexer = lex_thread->lexer;
+
+  // errors stop the lexer, the tokens before them were already sent
+  jmp_buf error_jmp;
+  lex_thread->compiler.error_jmp = &error_jmp;
+  if (!setjmp (error_jmp))
+    {
+      lex_begin (lexer);
+
+      // so the tokens we've sent are recycled
+      lexer->tokens->lexer = lexer;
+
+      _Bool more = 1;
+      while (more
+             && !atomic_load_explicit (&lex_thread->stop,
+                                       memory_order_relaxed))
+        {
+          more = lex_next (lexer);
+          lex_thread_send (lex_thread, more);
+        }
+    }
+  else
+    {
+      lex_thread->failed = 1;
+    }
+
+  fclose (lex_thread->compiler.diagnostics);
+  ring_close (lex_thread->ring);
+  return NULL;
+}
+
+// frees what lex_thread_start made, once the thread is gone
+static void
+lex_thread_destroy (struct lex_thread *lex_thread)
+{
+  lex_process_free (lex_thread->lexer);
+  ring_free (lex_thread->ring);
+  compile_process_free_copy (&lex_thread->compiler);
+  free (lex_thread->diagnostics);
+  free (lex_thread);
+}
+
+struct lex_thread *
+lex_thread_start (struct compile_process *process,
+                  struct lex_process *lex_process)
+{
+  // the copy reads the input on its own, it has to be in memory
+  if (!process->cfile.data)
+    return NULL;
+
+  struct lex_thread *lex_thread = calloc (1, sizeof (struct lex_thread));
+  lex_thread->parent = process;
+
+  struct compile_process *compiler = &lex_thread->compiler;
+  compile_process_copy (compiler, process);
+  compiler->diagnostics = open_memstream (&lex_thread->diagnostics,
+                                          &lex_thread->diagnostics_len);
+
+  lex_thread->lexer
+      = lex_process_create (compiler, lex_process->function, NULL);
+  lex_thread->lexer->flags = lex_process->flags;
+  lex_thread->ring = ring_create (sizeof (struct lex_thread_item),
+                                  LEX_THREAD_RING_SIZE);
+  atomic_init (&lex_thread->stop, 0);
+
+  if (!compiler->diagnostics
+      || pthread_create (&lex_thread->thread, NULL, lex_thread_main,
+                         lex_thread)
+             != 0)
+    {
+      if (compiler->diagnostics)
+        fclose (compiler->diagnostics);
+
+      lex_thread_destroy (lex_thread);
+      return NULL;
+    }
+
+  return lex_thread;
+}
+
+_Bool
+lex_thread_next (struct lex_thread *lex_thread, struct token_stream *stream)
+{
+  struct lex_thread_item item;
+  while (ring_pop (lex_thread->ring, &item))
+    {
+      if (!item.is_brackets)
+        {
+          token_stream_put (stream, &item.token);
+          return 1;
+        }
+
+      token_stream_push_brackets (stream, &item.brackets);
+    }
+
+  if (!lex_thread->failed)
+    return 0;
+
+  // the error is reported as if the parser had just lexed it
+  compiler_fail (lex_thread->parent, lex_thread->diagnostics,
+                 lex_thread->diagnostics_len);
+  return 0;
+}
+
+void
+lex_thread_free (struct lex_thread *lex_thread)
+{
+  // the lexer might be waiting for room in the ring, so we keep taking what
+  // it sends until it notices
+  atomic_store_explicit (&lex_thread->stop, 1, memory_order_relaxed);
+  struct lex_thread_item item;
+  while (ring_pop (lex_thread->ring, &item))
+    {
+    }
+
+  pthread_join (lex_thread->thread, NULL);
+  lex_thread_destroy (lex_thread);
+}
@@ -5,6 +5,7 @@
  */
 #include "compiler.h"
 #include "helpers/buffer.h"
+#include "helpers/scan.h"
 #include "helpers/vector.h"
 
 #include <assert.h>
@@ -12,161 +13,244 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define LEX_GETC_IF(buffer, c, exp)                                           \
-  for (c = peekc (); exp; c = peekc ())                                       \
+#define LEX_GETC_IF(lex_process, buffer, c, exp)                              \
+  for (c = peekc (lex_process); exp; c = peekc (lex_process))                 \
     {                                                                         \
       buffer_write (buffer, c);                                               \
-      nextc ();                                                               \
+      nextc (lex_process);                                                    \
     }
 
-struct token *read_next_token ();
-_Bool lex_is_in_expression ();
-
-static struct lex_process *lex_process;
-static struct token tmp_token;
+struct token *read_next_token (struct lex_process *lex_process);
+_Bool lex_is_in_expression (struct lex_process *lex_process);
 
 static char
-peekc ()
+peekc (struct lex_process *lex_process)
 {
   return lex_process->function->peek_char (lex_process);
 }
 
 static char
-nextc ()
+nextc (struct lex_process *lex_process)
 {
   char c = lex_process->function->next_char (lex_process);
-
-  if (lex_is_in_expression ())
-    {
-      buffer_write (lex_process->parentheses_buffer, c);
-    }
-
-  lex_process->pos.col += 1;
-  if (c == '\n')
-    {
-      lex_process->pos.line += 1;
-      lex_process->pos.col = 1;
-    }
+  if (c != EOF)
+    lex_process->offset += 1;
 
   return c;
 }
 
 static void
-pushc (char c)
+pushc (struct lex_process *lex_process, char c)
 {
   lex_process->function->push_char (lex_process, c);
+  lex_process->offset -= 1;
+}
+
+// returns the characters not read yet when the input is resident in memory,
+// NULL if it can only be read one character at a time
+static const char *
+lex_input (struct lex_process *lex_process, size_t *left)
+{
+  if (!lex_process->function->input)
+    return NULL;
+
+  return lex_process->function->input (lex_process, left);
+}
+
+// consumes the first `n' characters returned by lex_input, as if each one of
+// them went through nextc
+static void
+lex_skip (struct lex_process *lex_process, size_t n)
+{
+  lex_process->offset += n;
+  lex_process->function->skip_chars (lex_process, n);
 }
 
 static char
-assert_next_char (char c)
+assert_next_char (struct lex_process *lex_process, char c)
 {
-  char next_c = nextc ();
+  char next_c = nextc (lex_process);
   assert (c == next_c);
   return next_c;
 }
 
-static struct pos
-lex_file_position ()
+// returns the scratch buffer for the text of a new token
+static struct buffer *
+lex_token_buffer (struct lex_process *lex_process)
 {
-  return lex_process->pos;
+  buffer_clear (lex_process->token_buffer);
+  return lex_process->token_buffer;
 }
 
-static struct token *
-lexer_last_token ()
+// interns the text of `buffer', which must not be null terminated
+static const char *
+lex_intern_buffer (struct lex_process *lex_process, struct buffer *buffer)
 {
-  return vector_back_or_null (lex_process->token_vec);
+  return intern_str (lex_process->compiler->strings, buffer_ptr (buffer),
+                     buffer->len);
 }
 
-static struct token *
-handle_whitespace ()
+// returns the last token pushed, -1 if there's none
+static int
+lexer_last_token (struct lex_process *lex_process)
 {
-  struct token *last_token = lexer_last_token ();
-  if (last_token)
-    {
-      last_token->whitespace = 1;
-    }
-
-  nextc ();
-  return read_next_token ();
+  return token_stream_last (lex_process->tokens);
 }
 
-const char *
-read_number_str ()
+// there's whitespace between the last token and the next one
+static void
+lex_mark_whitespace (struct lex_process *lex_process)
 {
-  const char *num = NULL;
-  struct buffer *buffer = buffer_create ();
-  char c = peekc ();
-  LEX_GETC_IF (buffer, c, (c >= '0' && c <= '9'));
-  buffer_write (buffer, 0x00);
-  return buffer_ptr (buffer);
+  int last_token = lexer_last_token (lex_process);
+  if (last_token >= 0)
+    {
+      token_stream_set_whitespace (lex_process->tokens, last_token);
+    }
 }
 
-struct token *
-token_create (struct token *_token)
+static void
+handle_whitespace (struct lex_process *lex_process)
 {
-  memcpy (&tmp_token, _token, sizeof (struct token));
-  tmp_token.pos = lex_file_position ();
+  lex_mark_whitespace (lex_process);
 
-  if (lex_is_in_expression ())
+  size_t left = 0;
+  const char *input = lex_input (lex_process, &left);
+  if (input)
     {
-      tmp_token.between_brackets
-          = buffer_ptr (lex_process->parentheses_buffer);
+      lex_skip (lex_process, scan_blanks (input, left));
+      return;
     }
 
-  return &tmp_token;
+  nextc (lex_process);
 }
 
-unsigned long long
-read_number ()
+struct token *
+token_create (struct lex_process *lex_process, struct token *_token)
 {
-  const char *s = read_number_str ();
-  return atoll (s);
+  struct token *token = &lex_process->token;
+  memcpy (token, _token, sizeof (struct token));
+  token->offset = lex_process->token_start;
+  token->len = lex_process->offset - lex_process->token_start;
+  return token;
 }
 
-int
-lexer_number_type (char c)
+// the text of the numeric literal at the current position, which is left in
+// the input if possible and copied into the token buffer otherwise
+static const char *
+read_number_str (struct lex_process *lex_process, size_t *len)
 {
-  int res = NUMBER_TYPE_NORMAL;
-
-  if (c == 'L')
+  size_t left = 0;
+  const char *input = lex_input (lex_process, &left);
+  if (input)
     {
-      res = NUMBER_TYPE_LONG;
+      *len = number_literal_length (input, left);
+      lex_skip (lex_process, *len);
+      return input;
     }
-  else if (c == 'f')
+
+  // same as number_literal_length, one character at a time
+  struct buffer *buffer = lex_token_buffer (lex_process);
+  char last = 0x00;
+  for (char c = peekc (lex_process);; c = peekc (lex_process))
     {
-      res = NUMBER_TYPE_FLOAT;
+      _Bool is_exponent_sign = (c == '+' || c == '-')
+                               && (last == 'e' || last == 'E' || last == 'p'
+                                   || last == 'P');
+      if (!isalnum ((unsigned char)c) && c != '_' && c != '.'
+          && !is_exponent_sign)
+        break;
+
+      buffer_write (buffer, c);
+      nextc (lex_process);
+      last = c;
     }
 
-  return res;
+  *len = buffer->len;
+  return buffer_ptr (buffer);
 }
 
 struct token *
-token_make_number_for_value (unsigned long number)
+token_make_number (struct lex_process *lex_process)
 {
-  int number_type = lexer_number_type (peekc ());
+  size_t len = 0;
+  const char *str = read_number_str (lex_process, &len);
 
-  if (number_type != NUMBER_TYPE_NORMAL)
+  struct token token = {};
+  switch (number_parse (str, len, &token))
     {
-      nextc ();
+    case NUMBER_PARSE_INVALID:
+      compiler_error (lex_process->compiler, "Invalid number `%.*s'",
+                      (int)len, str);
+      break;
+
+    case NUMBER_PARSE_INVALID_SUFFIX:
+      compiler_error (lex_process->compiler,
+                      "Invalid suffix on number `%.*s'", (int)len, str);
+      break;
+
+    case NUMBER_PARSE_TOO_LARGE:
+      compiler_error (lex_process->compiler,
+                      "The number `%.*s' is too large", (int)len, str);
+      break;
     }
 
-  return token_create (&(struct token){
-      .type = TOKEN_TYPE_NUMBER, .llnum = number, .num.type = number_type });
+  return token_create (lex_process, &token);
 }
 
-struct token *
-token_make_number ()
+// a `.' can start a number too, like in `.5'
+static _Bool
+lex_is_number_after_dot (struct lex_process *lex_process)
 {
-  return token_make_number_for_value (read_number ());
+  size_t left = 0;
+  const char *input = lex_input (lex_process, &left);
+  if (input)
+    return left > 1 && isdigit ((unsigned char)input[1]);
+
+  nextc (lex_process);
+  char c = peekc (lex_process);
+  pushc (lex_process, '.');
+  return isdigit ((unsigned char)c);
 }
 
+// makes a string that's left in the input, unless it has escapes. Returns
+// NULL if they have to be dealt with
 static struct token *
-token_make_string (char start_delim, char end_delim)
+token_make_string_from_input (struct lex_process *lex_process,
+                              const char *input, size_t left, char end_delim)
 {
-  struct buffer *buffer = buffer_create ();
-  assert (nextc () == start_delim);
-  char c = nextc ();
-  for (; c != end_delim && c != EOF; c = nextc ())
+  size_t len = 1;
+  while (len < left && input[len] != end_delim && input[len] != '\\')
+    len++;
+
+  if (len < left && input[len] == '\\')
+    return NULL;
+
+  // skip the closing delimiter too, if there's one
+  lex_skip (lex_process, len < left ? len + 1 : len);
+  return token_create (
+      lex_process,
+      &(struct token){ .type = TOKEN_TYPE_STRING, .text_len = len - 1 });
+}
+
+static struct token *
+token_make_string (struct lex_process *lex_process, char start_delim,
+                   char end_delim)
+{
+  size_t left = 0;
+  const char *input = lex_input (lex_process, &left);
+  if (input)
+    {
+      assert (input[0] == start_delim);
+      struct token *token
+          = token_make_string_from_input (lex_process, input, left, end_delim);
+      if (token)
+        return token;
+    }
+
+  struct buffer *buffer = lex_token_buffer (lex_process);
+  assert (nextc (lex_process) == start_delim);
+  char c = nextc (lex_process);
+  for (; c != end_delim && c != EOF; c = nextc (lex_process))
     {
       if (c == '\\')
         {
@@ -177,190 +261,227 @@ token_make_string (char start_delim, char end_delim)
       buffer_write (buffer, c);
     }
 
-  buffer_write (buffer, 0x00);
-  return token_create (&(struct token){ .type = TOKEN_TYPE_STRING,
-                                        .sval = buffer_ptr (buffer) });
-}
-
-static _Bool
-op_treated_as_one (char op)
-{
-  return op == '(' || op == '[' || op == ',' || op == '.' || op == '*'
-         || op == '?';
-}
-
-static _Bool
-is_single_operator (char op)
-{
-  return op == '+' || op == '-' || op == '/' || op == '*' || op == '='
-         || op == '>' || op == '<' || op == '|' || op == '&' || op == '^'
-         || op == '%' || op == '!' || op == '(' || op == '[' || op == ','
-         || op == '.' || op == '~' || op == '?';
-}
-
-_Bool
-op_valid (const char *op)
-{
-  return S_EQ (op, "+") || S_EQ (op, "-") || S_EQ (op, "*") || S_EQ (op, "/")
-         || S_EQ (op, "!") || S_EQ (op, "^") || S_EQ (op, "+=")
-         || S_EQ (op, "-=") || S_EQ (op, "*=") || S_EQ (op, "/=")
-         || S_EQ (op, ">>") || S_EQ (op, "<<") || S_EQ (op, ">=")
-         || S_EQ (op, "<=") || S_EQ (op, ">") || S_EQ (op, "<")
-         || S_EQ (op, "||") || S_EQ (op, "&&") || S_EQ (op, "|")
-         || S_EQ (op, "&") || S_EQ (op, "++") || S_EQ (op, "--")
-         || S_EQ (op, "=") || S_EQ (op, "!=") || S_EQ (op, "==")
-         || S_EQ (op, "->") || S_EQ (op, "(") || S_EQ (op, "[")
-         || S_EQ (op, ",") || S_EQ (op, ".") || S_EQ (op, "...")
-         || S_EQ (op, "~") || S_EQ (op, "?") || S_EQ (op, "%");
+  return token_create (
+      lex_process,
+      &(struct token){ .type = TOKEN_TYPE_STRING,
+                       .sval = lex_intern_buffer (lex_process, buffer) });
 }
 
-void
-read_op_flush_back_keep_first (struct buffer *buffer)
+// reads the longest operator at the current position
+int
+read_op (struct lex_process *lex_process)
 {
-  const char *data = buffer_ptr (buffer);
-  int len = buffer->len;
-  for (int i = len - 1; i >= 1; i--)
+  char c = nextc (lex_process);
+  int op = operator_start (c);
+  if (op == OPERATOR_NONE)
     {
-      if (data[i] == 0x00)
-        continue;
+      compiler_error (lex_process->compiler, "The operator `%c' is not valid",
+                      c);
+    }
 
-      pushc (data[i]);
+  int next_op = operator_next (op, peekc (lex_process));
+  while (next_op != OPERATOR_NONE)
+    {
+      nextc (lex_process);
+      op = next_op;
+      next_op = operator_next (op, peekc (lex_process));
     }
+
+  return op;
 }
 
-const char *
-read_op ()
+static void
+lex_new_expression (struct lex_process *lex_process)
 {
-  _Bool single_op = 1;
-  char op = nextc ();
-  struct buffer *buffer = buffer_create ();
-  buffer_write (buffer, op);
-
-  if (!op_treated_as_one (op))
+  if (lex_process->flags & LEX_PROCESS_FLAG_NO_BRACKETS)
     {
-      op = peekc ();
-      if (is_single_operator (op))
-        {
-          buffer_write (buffer, op);
-          nextc ();
-          single_op = 0;
-        }
+      token_stream_push_brackets (
+          lex_process->tokens,
+          &(struct token_brackets){ .open = lex_process->token_start,
+                                    .close = TOKEN_BRACKETS_UNMATCHED });
+      return;
     }
 
-  buffer_write (buffer, 0x00);
-  char *ptr = buffer_ptr (buffer);
-  if (!single_op)
-    {
-      if (!op_valid (ptr))
-        {
-          read_op_flush_back_keep_first (buffer);
-          ptr[1] = 0x00;
-        }
-    }
-  else if (!op_valid (ptr))
+  lex_process->current_expression_count++;
+  if (lex_process->current_expression_count == 1)
     {
-      compiler_error (lex_process->compiler, "The operator `%s' is not valid",
-                      ptr);
+      // we are called right after reading the `('
+      lex_process->expression_start = lex_process->token_start;
     }
-
-  return ptr;
 }
 
+// records the brackets that were opened at `expression_start' and closed at
+// `close'
 static void
-lex_new_expression ()
+lex_push_brackets (struct lex_process *lex_process, unsigned int close)
 {
-  lex_process->current_expression_count++;
-  if (lex_process->current_expression_count == 1)
-    {
-      lex_process->parentheses_buffer = buffer_create ();
-    }
+  token_stream_push_brackets (
+      lex_process->tokens,
+      &(struct token_brackets){ .open = lex_process->expression_start,
+                                .close = close });
 }
 
 static void
-lex_finish_expression ()
+lex_finish_expression (struct lex_process *lex_process)
 {
+  if (lex_process->flags & LEX_PROCESS_FLAG_NO_BRACKETS)
+    {
+      token_stream_push_brackets (
+          lex_process->tokens,
+          &(struct token_brackets){ .open = TOKEN_BRACKETS_UNMATCHED,
+                                    .close = lex_process->offset - 1 });
+      return;
+    }
+
   lex_process->current_expression_count--;
   if (lex_process->current_expression_count < 0)
     {
       compiler_error (lex_process->compiler,
                       "You closed an expression that was never opened");
     }
-}
 
-_Bool
-lex_is_in_expression ()
-{
-  return lex_process->current_expression_count > 0;
+  if (lex_process->current_expression_count == 0)
+    {
+      // we are called right after reading the `)'
+      lex_push_brackets (lex_process, lex_process->offset - 1);
+    }
 }
 
-_Bool
-keyword_is_datatype (const char *str)
+void
+lex_follow_brackets (struct lex_process *lex_process,
+                     struct token_brackets *brackets)
 {
-  return S_EQ (str, "void") || S_EQ (str, "char") || S_EQ (str, "int")
-         || S_EQ (str, "short") || S_EQ (str, "float") || S_EQ (str, "double")
-         || S_EQ (str, "long") || S_EQ (str, "struct") || S_EQ (str, "union");
+  _Bool open = brackets->close == TOKEN_BRACKETS_UNMATCHED;
+  unsigned int offset = open ? brackets->open : brackets->close;
+
+  // both brackets are a single character, and we are right after it
+  lex_process->token_start = offset;
+  lex_process->offset = offset + 1;
+  lex_process->compiler->offset = offset;
+
+  if (open)
+    lex_new_expression (lex_process);
+  else
+    lex_finish_expression (lex_process);
 }
 
 _Bool
-is_keyword (const char *str)
+lex_is_in_expression (struct lex_process *lex_process)
 {
-  return S_EQ (str, "unsigned") || S_EQ (str, "signed") || S_EQ (str, "char")
-         || S_EQ (str, "short") || S_EQ (str, "int") || S_EQ (str, "long")
-         || S_EQ (str, "float") || S_EQ (str, "double") || S_EQ (str, "void")
-         || S_EQ (str, "struct") || S_EQ (str, "union") || S_EQ (str, "static")
-         || S_EQ (str, "__ignore_typecheck") || S_EQ (str, "return")
-         || S_EQ (str, "include") || S_EQ (str, "sizeof") || S_EQ (str, "if")
-         || S_EQ (str, "else") || S_EQ (str, "while") || S_EQ (str, "for")
-         || S_EQ (str, "do") || S_EQ (str, "break") || S_EQ (str, "continue")
-         || S_EQ (str, "switch") || S_EQ (str, "case") || S_EQ (str, "default")
-         || S_EQ (str, "goto") || S_EQ (str, "typedef") || S_EQ (str, "const")
-         || S_EQ (str, "extern") || S_EQ (str, "restrict");
+  return lex_process->current_expression_count > 0;
 }
 
 static struct token *
-token_make_operator_or_string ()
+token_make_operator_or_string (struct lex_process *lex_process)
 {
-  char op = peekc ();
+  char op = peekc (lex_process);
   if (op == '<')
     {
       // check if this is an include statement, in case someone does `#include
-      // <abc.h>'
-      struct token *last_token = lexer_last_token ();
-      if (token_is_keyword (last_token, "include"))
+      // <abc.h>'. Dropped comments and lines in between make it an operator,
+      // the same as when they're kept
+      if (!lex_process->after_trivia
+          && token_is_keyword (lex_process->tokens,
+                               lexer_last_token (lex_process),
+                               KEYWORD_INCLUDE))
         {
-          return token_make_string ('<', '>');
+          return token_make_string (lex_process, '<', '>');
         }
     }
 
-  struct token *token = token_create (
-      &(struct token){ .type = TOKEN_TYPE_OPERATOR, .sval = read_op () });
+  int read = read_op (lex_process);
+  struct token *token = token_create (lex_process, &(struct token){
+      .type = TOKEN_TYPE_OPERATOR, .sval = operator_name (read), .op = read });
 
   if (op == '(')
     {
-      lex_new_expression ();
+      lex_new_expression (lex_process);
     }
 
   return token;
 }
 
+// the text of a comment read into `buffer', unless the comment is going to
+// be dropped
+static const char *
+lex_comment_text (struct lex_process *lex_process, struct buffer *buffer)
+{
+  if (lex_process->flags & LEX_PROCESS_FLAG_DROP_TRIVIA)
+    return NULL;
+
+  return lex_intern_buffer (lex_process, buffer);
+}
+
 struct token *
-token_make_one_line_comment ()
+token_make_one_line_comment (struct lex_process *lex_process)
 {
-  struct buffer *buffer = buffer_create ();
+  size_t left = 0;
+  const char *input = lex_input (lex_process, &left);
+  if (input)
+    {
+      size_t len = scan_line (input, left);
+      lex_skip (lex_process, len);
+      return token_create (
+          lex_process,
+          &(struct token){ .type = TOKEN_TYPE_COMMENT, .text_len = len });
+    }
+
+  struct buffer *buffer = lex_token_buffer (lex_process);
   char c = 0;
-  LEX_GETC_IF (buffer, c, c != '\n' && c != EOF);
-  return token_create (&(struct token){ .type = TOKEN_TYPE_COMMENT,
-                                        .sval = buffer_ptr (buffer) });
+  LEX_GETC_IF (lex_process, buffer, c, c != '\n' && c != EOF);
+  return token_create (
+      lex_process,
+      &(struct token){ .type = TOKEN_TYPE_COMMENT,
+                       .sval = lex_comment_text (lex_process, buffer) });
 }
 
 struct token *
-token_make_multiline_comment ()
+token_make_multiline_comment_from_input (struct lex_process *lex_process,
+                                         const char *input, size_t left)
 {
-  struct buffer *buffer = buffer_create ();
+  size_t len = scan_comment_end (input, left);
+  if (len == left)
+    {
+      lex_skip (lex_process, left);
+      compiler_error (lex_process->compiler,
+                      "You didn't close a multiline comment");
+    }
+
+  // the asterisks never make it into the comment text, so only comments
+  // without them can be left in the input
+  const char *str = NULL;
+  if (!(lex_process->flags & LEX_PROCESS_FLAG_DROP_TRIVIA)
+      && memchr (input, '*', len))
+    {
+      struct buffer *buffer = lex_token_buffer (lex_process);
+      for (size_t i = 0; i < len; i++)
+        {
+          if (input[i] != '*')
+            buffer_write (buffer, input[i]);
+        }
+
+      str = lex_intern_buffer (lex_process, buffer);
+    }
+
+  // skip the comment and its closing "*/"
+  lex_skip (lex_process, len + 2);
+  return token_create (lex_process, &(struct token){
+      .type = TOKEN_TYPE_COMMENT, .sval = str, .text_len = len });
+}
+
+struct token *
+token_make_multiline_comment (struct lex_process *lex_process)
+{
+  size_t left = 0;
+  const char *input = lex_input (lex_process, &left);
+  if (input)
+    return token_make_multiline_comment_from_input (lex_process, input, left);
+
+  struct buffer *buffer = lex_token_buffer (lex_process);
   char c = 0;
   while (1)
     {
-      LEX_GETC_IF (buffer, c, c != '*' && c != EOF);
+      LEX_GETC_IF (lex_process, buffer, c, c != '*' && c != EOF);
       if (c == EOF)
         {
           // we never closed the comment, but the file ended
@@ -370,101 +491,127 @@ token_make_multiline_comment ()
       else if (c == '*')
         {
           // skip the asterisk
-          nextc ();
+          nextc (lex_process);
 
-          if (peekc () == '/')
+          if (peekc (lex_process) == '/')
             {
-              nextc ();
+              nextc (lex_process);
               break;
             }
         }
     }
 
-  return token_create (&(struct token){ .type = TOKEN_TYPE_COMMENT,
-                                        .sval = buffer_ptr (buffer) });
+  return token_create (
+      lex_process,
+      &(struct token){ .type = TOKEN_TYPE_COMMENT,
+                       .sval = lex_comment_text (lex_process, buffer) });
 }
 
 struct token *
-handle_comment ()
+handle_comment (struct lex_process *lex_process)
 {
-  char c = peekc ();
+  char c = peekc (lex_process);
   if (c == '/')
     {
-      nextc ();
-      if (peekc () == '/')
+      nextc (lex_process);
+      if (peekc (lex_process) == '/')
         {
-          nextc ();
-          return token_make_one_line_comment ();
+          nextc (lex_process);
+          return token_make_one_line_comment (lex_process);
         }
-      else if (peekc () == '*')
+      else if (peekc (lex_process) == '*')
         {
-          nextc ();
-          return token_make_multiline_comment ();
+          nextc (lex_process);
+          return token_make_multiline_comment (lex_process);
         }
 
       // if we reached this part of the code, it's probably a division what
       // we're dealing with, instead of a dictionary, so push it back and make
       // operator
-      pushc ('/');
-      return token_make_operator_or_string ();
+      pushc (lex_process, '/');
+      return token_make_operator_or_string (lex_process);
     }
 
   return NULL;
 }
 
 static struct token *
-token_make_symbol ()
+token_make_symbol (struct lex_process *lex_process)
 {
-  char c = nextc ();
+  char c = nextc (lex_process);
   if (c == ')')
     {
-      lex_finish_expression ();
+      lex_finish_expression (lex_process);
     }
 
-  struct token *token
-      = token_create (&(struct token){ .type = TOKEN_TYPE_SYMBOL, .cval = c });
+  struct token *token = token_create (
+      lex_process, &(struct token){ .type = TOKEN_TYPE_SYMBOL, .cval = c });
   return token;
 }
 
 static struct token *
-token_make_identifier_or_keyword ()
+token_make_identifier_or_keyword (struct lex_process *lex_process)
 {
-  struct buffer *buffer = buffer_create ();
-  char c = 0;
-  LEX_GETC_IF (
-      buffer, c,
-      (c >= 'a' && c <= 'z')
-          || (c >= 'A' && c <= 'Z' || (c >= '0' && c <= '9') || c == '_'));
-  buffer_write (buffer, 0x00);
+  const char *text = NULL;
+  size_t len = 0;
+  size_t left = 0;
+  const char *input = lex_input (lex_process, &left);
+  if (input)
+    {
+      text = input;
+      len = scan_identifier (input, left);
+    }
+  else
+    {
+      struct buffer *buffer = lex_token_buffer (lex_process);
+      char c = 0;
+      LEX_GETC_IF (lex_process, buffer, c,
+                   (c >= 'a' && c <= 'z')
+                       || (c >= 'A' && c <= 'Z' || (c >= '0' && c <= '9')
+                           || c == '_'));
+      text = buffer_ptr (buffer);
+      len = buffer->len;
+    }
 
   // check if keyword
-  if (is_keyword (buffer_ptr (buffer)))
+  int keyword = keyword_lookup (text, len);
+
+  // identifiers in the input stay there, the parser copies the ones it needs
+  const char *str = NULL;
+  if (input)
+    lex_skip (lex_process, len);
+  else if (keyword == KEYWORD_NONE)
+    str = intern_str (lex_process->compiler->strings, text, len);
+
+  if (keyword != KEYWORD_NONE)
     {
-      return token_create (&(struct token){ .type = TOKEN_TYPE_KEYWORD,
-                                            .sval = buffer_ptr (buffer) });
+      return token_create (
+          lex_process,
+          &(struct token){ .type = TOKEN_TYPE_KEYWORD, .keyword = keyword });
     }
 
-  return token_create (&(struct token){ .type = TOKEN_TYPE_IDENTIFIER,
-                                        .sval = buffer_ptr (buffer) });
+  return token_create (lex_process, &(struct token){
+      .type = TOKEN_TYPE_IDENTIFIER, .sval = str, .text_len = len });
 }
 
 struct token *
-read_special_token ()
+read_special_token (struct lex_process *lex_process)
 {
-  char c = peekc ();
+  char c = peekc (lex_process);
   if (isalpha (c) || c == '_')
     {
-      return token_make_identifier_or_keyword ();
+      return token_make_identifier_or_keyword (lex_process);
     }
 
   return NULL;
 }
 
 struct token *
-token_make_newline ()
+token_make_newline (struct lex_process *lex_process)
 {
-  nextc ();
-  return token_create (&(struct token){ .type = TOKEN_TYPE_NEWLINE });
+  nextc (lex_process);
+  return token_create (lex_process,
+                       &(struct token){ .type = TOKEN_TYPE_NEWLINE });
 }
 
 char
@@ -493,111 +640,19 @@ lex_get_escaped_char (char c)
   return co;
 }
 
-void
-lexer_pop_token ()
-{
-  vector_pop (lex_process->token_vec);
-}
-
-_Bool
-is_hex_char (char c)
-{
-  c = tolower (c);
-  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
-}
-
-const char *
-read_hex_number_str ()
-{
-  struct buffer *buffer = buffer_create ();
-  char c = peekc ();
-  LEX_GETC_IF (buffer, c, is_hex_char (c));
-  buffer_write (buffer, 0x00);
-  return buffer_ptr (buffer);
-}
-
-struct token *
-token_make_special_number_hex ()
-{
-  // skip the "x"
-  nextc ();
-
-  unsigned long number = 0;
-  const char *number_str = read_hex_number_str ();
-  number = strtol (number_str, 0, 16);
-  return token_make_number_for_value (number);
-}
-
-void
-lexer_validate_binary_string (const char *str)
-{
-  size_t len = strlen (str);
-  for (int i = 0; i < len; i++)
-    {
-      if (str[i] != '0' && str[i] != '1')
-        compiler_error (lex_process->compiler,
-                        "This is not a valid binary number");
-    }
-}
-
 struct token *
-token_make_special_number_binary ()
+token_make_quote (struct lex_process *lex_process)
 {
-  // skip the "b"
-  nextc ();
-
-  unsigned long number = 0;
-  const char *number_str = read_number_str ();
-  lexer_validate_binary_string (number_str);
-  number = strtol (number_str, 0, 2);
-  return token_make_number_for_value (number);
-}
-
-struct token *
-token_make_special_number ()
-{
-  struct token *token = NULL;
-  struct token *last_token = lexer_last_token ();
-
-  if (!last_token
-      || !(last_token->type == TOKEN_TYPE_NUMBER && last_token->llnum == 0))
-    {
-      // if the last token is not a number and/or its value is not `0', it
-      // means we are not dealing with an special number but an identifier
-      // instead
-      return token_make_identifier_or_keyword ();
-    }
-
-  lexer_pop_token ();
-
-  char c = peekc ();
-  if (c == 'x')
-    {
-      // hex number
-      token = token_make_special_number_hex ();
-    }
-  else if (c == 'b')
-    {
-      // binary number
-      token = token_make_special_number_binary ();
-    }
-
-  return token;
-}
-
-struct token *
-token_make_quote ()
-{
-  assert_next_char ('\'');
-  char c = nextc ();
+  assert_next_char (lex_process, '\'');
+  char c = nextc (lex_process);
   if (c == '\\')
     {
       // we have an escape
-      c = nextc (); // pop the next character
+      c = nextc (lex_process); // pop the next character
       c = lex_get_escaped_char (c);
     }
 
-  if (nextc () != '\'')
+  if (nextc (lex_process) != '\'')
     {
       compiler_error (
           lex_process->compiler,
@@ -605,55 +660,61 @@ token_make_quote ()
     }
 
   return token_create (
-      &(struct token){ .type = TOKEN_TYPE_NUMBER, .cval = c });
+      lex_process, &(struct token){ .type = TOKEN_TYPE_NUMBER, .cval = c });
 }
 
 struct token *
-read_next_token ()
+read_next_token (struct lex_process *lex_process)
 {
   struct token *token = NULL;
-  char c = peekc ();
+  char c = peekc (lex_process);
+
+  // we don't care about whitespace, skip all of it
+  while (c == ' ' || c == '\t')
+    {
+      handle_whitespace (lex_process);
+      c = peekc (lex_process);
+    }
+
+  lex_process->token_start = lex_process->offset;
 
-  token = handle_comment ();
+  // errors from now on are about this token
+  lex_process->compiler->offset = lex_process->token_start;
+
+  token = handle_comment (lex_process);
   if (token)
     return token;
 
   switch (c)
     {
     NUMERIC_CASE:
-      token = token_make_number ();
+      token = token_make_number (lex_process);
       break;
 
     OPERATOR_CASE_EXCLUDING_DIVISION:
-      token = token_make_operator_or_string ();
-      break;
+      if (c == '.' && lex_is_number_after_dot (lex_process))
+        {
+          token = token_make_number (lex_process);
+          break;
+        }
 
-    SYMBOL_CASE:
-      token = token_make_symbol ();
+      token = token_make_operator_or_string (lex_process);
       break;
 
-    case 'x':
-    case 'b':
-      // if it's hex, we've already tokenised the 0
-      token = token_make_special_number ();
+    SYMBOL_CASE:
+      token = token_make_symbol (lex_process);
       break;
 
     case '"':
-      token = token_make_string ('"', '"');
+      token = token_make_string (lex_process, '"', '"');
       break;
 
     case '\'':
-      token = token_make_quote ();
-      break;
-
-      // we don;t care aabout whitespace, ignore them
-    case ' ':
-    case '\t':
-      token = handle_whitespace ();
+      token = token_make_quote (lex_process);
       break;
 
     case '\n':
-      token = token_make_newline ();
+      token = token_make_newline (lex_process);
       break;
 
     case EOF:
@@ -661,7 +722,7 @@ read_next_token ()
       break;
 
     default:
-      token = read_special_token ();
+      token = read_special_token (lex_process);
       if (!token)
         compiler_error (lex_process->compiler, "Unexpected token");
       break;
@@ -669,19 +730,64 @@ read_next_token ()
   return token;
 }
 
-int
-lex (struct lex_process *process)
+void
+lex_begin (struct lex_process *process)
 {
   process->current_expression_count = 0;
-  process->parentheses_buffer = NULL;
-  lex_process = process;
-  process->pos.fname = process->compiler->cfile.abs_path;
+  process->offset = 0;
+  process->after_trivia = 0;
 
-  struct token *token = read_next_token ();
-  while (token)
+  // tokens read in bulk are left in the input
+  size_t left = 0;
+  process->tokens->source = lex_input (process, &left);
+  process->tokens->significant_only
+      = process->flags & LEX_PROCESS_FLAG_DROP_TRIVIA;
+}
+
+static _Bool
+lex_is_trivia (struct token *token)
+{
+  return token->type == TOKEN_TYPE_NEWLINE
+         || token->type == TOKEN_TYPE_COMMENT
+         || (token->type == TOKEN_TYPE_SYMBOL && token->cval == '\\');
+}
+
+_Bool
+lex_next (struct lex_process *process)
+{
+  struct token *token = read_next_token (process);
+  if (token && (process->flags & LEX_PROCESS_FLAG_DROP_TRIVIA)
+      && lex_is_trivia (token))
+    {
+      // as far as the tokens around it are concerned, it was whitespace
+      lex_mark_whitespace (process);
+      process->after_trivia = 1;
+      return 1;
+    }
+
+  if (token)
+    {
+      process->after_trivia = 0;
+      token_stream_push (process->tokens, token);
+      return 1;
+    }
+
+  if (lex_is_in_expression (process))
+    {
+      // brackets that were never closed take the rest of the file
+      lex_push_brackets (process, process->offset);
+      process->current_expression_count = 0;
+    }
+
+  return 0;
+}
+
+int
+lex (struct lex_process *process)
+{
+  lex_begin (process);
+  while (lex_next (process))
     {
-      vector_push (process->token_vec, token);
-      token = read_next_token ();
     }
 
   return LEXICAL_ANALYSIS_ALL_OK;
@@ -703,15 +809,35 @@ lexer_string_buffer_peekc (struct lex_process *process)
 
 void
 lexer_string_buffer_pushc (struct lex_process *process, char c)
+{
+  // tokens point into the buffer, so we give back the character we've just
+  // read instead of writing a new one
+  struct buffer *buf = lex_process_private (process);
+  assert (buf->rindex > 0 && buf->data[buf->rindex - 1] == c);
+  buf->rindex--;
+}
+
+const char *
+lexer_string_buffer_input (struct lex_process *process, size_t *left)
+{
+  struct buffer *buf = lex_process_private (process);
+  *left = buf->len - buf->rindex;
+  return buf->data + buf->rindex;
+}
+
+void
+lexer_string_buffer_skip_chars (struct lex_process *process, size_t n)
 {
   struct buffer *buf = lex_process_private (process);
-  buffer_write (buf, c);
+  buf->rindex += n;
 }
 
 struct lex_process_functions lexer_string_buffer_functions
     = { .next_char = lexer_string_buffer_nextc,
         .peek_char = lexer_string_buffer_peekc,
-        .push_char = lexer_string_buffer_pushc };
+        .push_char = lexer_string_buffer_pushc,
+        .input = lexer_string_buffer_input,
+        .skip_chars = lexer_string_buffer_skip_chars };
 
 struct lex_process *
 tokens_build_for_string (struct compile_process *compiler, const char *str)
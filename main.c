@@ -5,25 +5,195 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "compiler.h"
+#include "helpers/pool.h"
+
+struct driver_file
+{
+  const char *fname;
+  int res;
+
+  // what compiling it printed, shown once every file before it is shown
+  char *diagnostics;
+  size_t diagnostics_len;
+  _Bool done;
+};
+
+struct driver
+{
+  struct driver_file *files;
+  int total_files;
+  int flags;
+  int lex_threads;
+
+  // files are reported in the order they were given, `next_report' is the
+  // first one we are still waiting for
+  pthread_mutex_t report_lock;
+  int next_report;
+};
+
+static void
+driver_usage (const char *program)
+{
+  fprintf (stderr, "usage: %s [-jN] [-pN] [-s] [-t] file...\n", program);
+  fprintf (stderr, "  -jN  compile up to N files at once (-j alone uses "
+                   "every core)\n");
+  fprintf (stderr, "  -pN  lex every file on up to N threads (-p alone uses "
+                   "every core)\n");
+  fprintf (stderr, "  -s   stream tokens from the lexer to the parser\n");
+  fprintf (stderr, "  -t   lex on a thread of its own while parsing\n");
+}
+
+// `file.c' is compiled into `file', anything else into `file.out'
+static char *
+driver_output_name (const char *fname)
+{
+  size_t len = strlen (fname);
+  const char *extension = "";
+  if (len > 2 && strcmp (fname + len - 2, ".c") == 0)
+    len -= 2;
+  else
+    extension = ".out";
+
+  char *out = malloc (len + strlen (extension) + 1);
+  memcpy (out, fname, len);
+  strcpy (out + len, extension);
+  return out;
+}
+
+// prints the diagnostics of every finished file that's next in line
+static void
+driver_report (struct driver *driver, int file)
+{
+  pthread_mutex_lock (&driver->report_lock);
+  driver->files[file].done = 1;
+  while (driver->next_report < driver->total_files
+         && driver->files[driver->next_report].done)
+    {
+      struct driver_file *next = &driver->files[driver->next_report];
+      fwrite (next->diagnostics, 1, next->diagnostics_len, stderr);
+      free (next->diagnostics);
+      next->diagnostics = NULL;
+      driver->next_report++;
+    }
+  pthread_mutex_unlock (&driver->report_lock);
+}
+
+static void
+driver_compile (int job, void *private)
+{
+  struct driver *driver = private;
+  struct driver_file *file = &driver->files[job];
+
+  FILE *diagnostics
+      = open_memstream (&file->diagnostics, &file->diagnostics_len);
+  char *out_fname = driver_output_name (file->fname);
+  file->res = compile_file (file->fname, out_fname, driver->flags,
+                            driver->lex_threads,
+                            diagnostics ? diagnostics : stderr);
+  free (out_fname);
+
+  if (diagnostics)
+    fclose (diagnostics);
+
+  driver_report (driver, job);
+}
+
+static double
+driver_seconds (clockid_t clock)
+{
+  struct timespec ts;
+  clock_gettime (clock, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
 int
-main (void)
+main (int argc, char **argv)
 {
-  int res = compile_file ("test.c", "test", 0);
-  if (res == COMPILER_FILE_COMPILED_OK)
+  struct driver driver = { 0 };
+  driver.files = calloc (argc, sizeof (struct driver_file));
+  pthread_mutex_init (&driver.report_lock, NULL);
+
+  int jobs = 1;
+  for (int i = 1; i < argc; i++)
     {
-      printf ("Compilation successful!\n");
+      const char *arg = argv[i];
+      if (strncmp (arg, "-j", 2) == 0)
+        {
+          jobs = arg[2] ? atoi (arg + 2) : sysconf (_SC_NPROCESSORS_ONLN);
+          if (jobs < 1)
+            {
+              driver_usage (argv[0]);
+              return 1;
+            }
+        }
+      else if (strncmp (arg, "-p", 2) == 0)
+        {
+          driver.lex_threads
+              = arg[2] ? atoi (arg + 2) : sysconf (_SC_NPROCESSORS_ONLN);
+          if (driver.lex_threads < 1)
+            {
+              driver_usage (argv[0]);
+              return 1;
+            }
+        }
+      else if (strcmp (arg, "-s") == 0)
+        {
+          driver.flags |= COMPILE_PROCESS_FLAG_STREAM_TOKENS;
+        }
+      else if (strcmp (arg, "-t") == 0)
+        {
+          driver.flags |= COMPILE_PROCESS_FLAG_LEX_THREAD;
+        }
+      else if (arg[0] == '-' && arg[1])
+        {
+          driver_usage (argv[0]);
+          return 1;
+        }
+      else
+        {
+          driver.files[driver.total_files++].fname = arg;
+        }
     }
-  else if (res == COMPILER_FAILED_WITH_ERRORS)
+
+  if (driver.total_files == 0)
+    {
+      driver_usage (argv[0]);
+      return 1;
+    }
+
+  double wall = driver_seconds (CLOCK_MONOTONIC);
+  double cpu = driver_seconds (CLOCK_PROCESS_CPUTIME_ID);
+  pool_run (jobs, driver.total_files, driver_compile, &driver);
+  wall = driver_seconds (CLOCK_MONOTONIC) - wall;
+  cpu = driver_seconds (CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+  int failed = 0;
+  for (int i = 0; i < driver.total_files; i++)
     {
-      printf ("There's  been an error compiling\n");
+      if (driver.files[i].res != COMPILER_FILE_COMPILED_OK)
+        failed++;
+    }
+
+  if (failed)
+    {
+      printf ("There's been an error compiling %d of %d files\n", failed,
+              driver.total_files);
     }
   else
     {
-      printf ("Unknown response for compilation\n");
+      printf ("Compilation successful!\n");
     }
 
-  return 0;
+  fprintf (stderr, "%d files, %d jobs: %.3fs wall, %.3fs cpu\n",
+           driver.total_files, jobs, wall, cpu);
+
+  pthread_mutex_destroy (&driver.report_lock);
+  free (driver.files);
+  return failed ? 1 : 0;
 }
@@ -6,84 +6,356 @@
 
 #include "compiler.h"
 #include <assert.h>
+#include <limits.h>
 
-struct vector *node_vector = NULL;
-struct vector *node_vector_root = NULL;
+#define AST_INITIAL_CAPACITY 256
+
+static void *
+ast_grow_array (void *array, int capacity, size_t size)
+{
+  void *new_array = realloc (array, capacity * size);
+  assert (new_array);
+  return new_array;
+}
+
+static void
+ast_grow (struct ast *ast, int capacity)
+{
+  ast->type = ast_grow_array (ast->type, capacity, sizeof (unsigned char));
+  ast->flags = ast_grow_array (ast->flags, capacity, sizeof (unsigned char));
+  ast->offset = ast_grow_array (ast->offset, capacity, sizeof (unsigned int));
+  ast->data = ast_grow_array (ast->data, capacity, sizeof (unsigned int));
+  ast->capacity = capacity;
+}
+
+struct ast *
+ast_create (struct intern *strings)
+{
+  struct ast *ast = calloc (1, sizeof (struct ast));
+  ast->strings = strings;
+  ast->exps = vector_create (sizeof (struct node_exp));
+  ast->vars = vector_create (sizeof (struct node_var));
+  ast->numbers = vector_create (sizeof (struct node_number));
+  ast_grow (ast, AST_INITIAL_CAPACITY);
+  return ast;
+}
 
 void
-node_set_vector (struct vector *vec, struct vector *root_vec)
+ast_free (struct ast *ast)
+{
+  free (ast->type);
+  free (ast->flags);
+  free (ast->offset);
+  free (ast->data);
+  vector_free (ast->exps);
+  vector_free (ast->vars);
+  vector_free (ast->numbers);
+  free (ast);
+}
+
+struct ast_mark
+ast_mark (struct ast *ast)
+{
+  return (struct ast_mark){ .nodes = ast->count,
+                            .exps = vector_count (ast->exps),
+                            .vars = vector_count (ast->vars),
+                            .numbers = vector_count (ast->numbers) };
+}
+
+void
+ast_rewind (struct ast *ast, struct ast_mark mark)
+{
+  assert (mark.nodes <= ast->count);
+  ast->count = mark.nodes;
+  vector_truncate (ast->exps, mark.exps);
+  vector_truncate (ast->vars, mark.vars);
+  vector_truncate (ast->numbers, mark.numbers);
+}
+
+// what goes in `data' for a number, pushing it to `numbers' if needed.
+// `slot' is a payload that can be reused instead, or -1
+static unsigned int
+ast_number_data (struct ast *ast, struct node *node, int *flags, int slot)
+{
+  if (node->num.type == NUMBER_TYPE_NORMAL && node->num.flags == 0
+      && node->llnum <= UINT_MAX)
+    return node->llnum;
+
+  struct node_number number = { .num = node->num };
+  if (number_is_float (node->num.type))
+    number.dval = node->dval;
+  else
+    number.llnum = node->llnum;
+
+  *flags |= AST_FLAG_BIG_NUMBER;
+  if (slot >= 0)
+    {
+      *(struct node_number *)vector_at (ast->numbers, slot) = number;
+      return slot;
+    }
+
+  vector_push (ast->numbers, &number);
+  return vector_count (ast->numbers) - 1;
+}
+
+static struct node_number *
+ast_big_number (struct ast *ast, int node)
 {
-  node_vector = vec;
-  node_vector_root = root_vec;
+  if (!(ast->flags[node] & AST_FLAG_BIG_NUMBER))
+    return NULL;
+
+  return vector_at (ast->numbers, ast->data[node]);
 }
 
 void
-node_push (struct node *node)
+node_push (struct compile_process *process, int node)
 {
-  vector_push (node_vector, &node);
+  vector_push (process->node_vec, &node);
 }
 
-struct node *
-node_peek_or_null ()
+int
+node_peek_or_null (struct compile_process *process)
 {
-  return vector_back_ptr_or_null (node_vector);
+  int *node = vector_back_or_null (process->node_vec);
+  return node ? *node : -1;
 }
 
-struct node *
-node_peek ()
+int
+node_peek (struct compile_process *process)
 {
-  return *(struct node **)(vector_back (node_vector));
+  return *(int *)(vector_back (process->node_vec));
 }
 
-struct node *
-node_pop ()
+int
+node_pop (struct compile_process *process)
 {
-  struct node *last_node = vector_back_ptr (node_vector);
-  struct node *last_node_root
-      = vector_empty (node_vector)
-            ? NULL
-            : vector_back_ptr_or_null (node_vector_root);
-  vector_pop (node_vector);
+  // see parser_checkpoint
+  assert (vector_count (process->node_vec) > process->parser.node_floor);
 
-  if (last_node == last_node_root)
-    vector_pop (node_vector_root);
+  int last_node = node_peek (process);
+  int *last_node_root = vector_empty (process->node_vec)
+                            ? NULL
+                            : vector_back_or_null (process->node_tree_vec);
+  vector_pop (process->node_vec);
+
+  if (last_node_root && last_node == *last_node_root)
+    vector_pop (process->node_tree_vec);
 
   return last_node;
 }
 
 _Bool
-node_is_expressionable (struct node *node)
+node_is_expressionable (struct compile_process *process, int node)
 {
-  return node->type == NODE_TYPE_EXPRESSION
-         || node->type == NODE_TYPE_EXPRESSION_PARENTHESES
-         || node->type == NODE_TYPE_UNARY || node->type == NODE_TYPE_IDENTIFIER
-         || node->type == NODE_TYPE_NUMBER || node->type == NODE_TYPE_STRING;
+  int type = node_type (process, node);
+  return type == NODE_TYPE_EXPRESSION
+         || type == NODE_TYPE_EXPRESSION_PARENTHESES || type == NODE_TYPE_UNARY
+         || type == NODE_TYPE_IDENTIFIER || type == NODE_TYPE_NUMBER
+         || type == NODE_TYPE_STRING;
 }
 
-struct node *
-node_peek_expressionable_or_null ()
+int
+node_peek_expressionable_or_null (struct compile_process *process)
 {
-  struct node *last_node = node_peek_or_null ();
-  return node_is_expressionable (last_node) ? last_node : NULL;
+  int last_node = node_peek_or_null (process);
+  if (last_node < 0)
+    return -1;
+
+  return node_is_expressionable (process, last_node) ? last_node : -1;
 }
 
 void
-make_exp_node (struct node *left_node, struct node *right_node, const char *op)
+make_exp_node (struct compile_process *process, int left_node,
+               int right_node, int op)
 {
-  assert (left_node);
-  assert (right_node);
-  node_create (&(struct node){ .type = NODE_TYPE_EXPRESSION,
-                               .exp.left = left_node,
-                               .exp.right = right_node,
-                               .exp.op = op });
+  assert (left_node >= 0);
+  assert (right_node >= 0);
+  node_create (process, &(struct node){
+      .type = NODE_TYPE_EXPRESSION,
+      .offset = node_offset (process, left_node),
+      .exp = { .left = left_node, .right = right_node, .op = op } });
 }
 
-struct node *
-node_create (struct node *_node)
+int
+node_create (struct compile_process *process, struct node *_node)
 {
-  struct node *node = malloc (sizeof (struct node));
-  memcpy (node, _node, sizeof (struct node));
+  struct ast *ast = process->ast;
+  if (ast->count == ast->capacity)
+    ast_grow (ast, ast->capacity * 2);
+
+  int flags = _node->flags;
+  unsigned int data = 0;
+  switch (_node->type)
+    {
+    case NODE_TYPE_NUMBER:
+      data = ast_number_data (ast, _node, &flags, -1);
+      break;
+
+    case NODE_TYPE_IDENTIFIER:
+    case NODE_TYPE_STRING:
+      data = intern_id (ast->strings, _node->sval);
+      break;
+
+    case NODE_TYPE_EXPRESSION:
+      vector_push (ast->exps, &_node->exp);
+      data = vector_count (ast->exps) - 1;
+      break;
+
+    case NODE_TYPE_VARIABLE:
+      vector_push (ast->vars, &_node->var);
+      data = vector_count (ast->vars) - 1;
+      break;
+
+    case NODE_TYPE_EXPRESSION_PARENTHESES:
+      data = _node->parenthesis.exp;
+      break;
+    }
+
+  int node = ast->count++;
+  ast->type[node] = _node->type;
+  ast->flags[node] = flags;
+  ast->offset[node] = _node->offset;
+  ast->data[node] = data;
+
 #warning "we should set the binded owner and binded function here"
-  node_push (node);
+  node_push (process, node);
   return node;
 }
+
+void
+node_set_number (struct compile_process *process, int node,
+                 struct node *number)
+{
+  struct ast *ast = process->ast;
+  assert (ast->type[node] == NODE_TYPE_NUMBER);
+
+  int flags = ast->flags[node] & ~AST_FLAG_BIG_NUMBER;
+  int slot = -1;
+  if (ast->flags[node] & AST_FLAG_BIG_NUMBER)
+    slot = ast->data[node];
+
+  ast->data[node] = ast_number_data (ast, number, &flags, slot);
+  ast->flags[node] = flags;
+
+  // the number fits in the node now, its old payload isn't needed
+  if (!(flags & AST_FLAG_BIG_NUMBER) && slot >= 0
+      && slot == vector_count (ast->numbers) - 1)
+    vector_pop (ast->numbers);
+}
+
+void
+node_discard (struct compile_process *process, int node)
+{
+  struct ast *ast = process->ast;
+  if (node != ast->count - 1)
+    return;
+
+  struct vector *payloads = NULL;
+  switch (ast->type[node])
+    {
+    case NODE_TYPE_NUMBER:
+      if (ast->flags[node] & AST_FLAG_BIG_NUMBER)
+        payloads = ast->numbers;
+      break;
+
+    case NODE_TYPE_EXPRESSION:
+      payloads = ast->exps;
+      break;
+
+    case NODE_TYPE_VARIABLE:
+      payloads = ast->vars;
+      break;
+    }
+
+  if (payloads && (int)ast->data[node] == vector_count (payloads) - 1)
+    vector_pop (payloads);
+
+  ast->count--;
+}
+
+int
+node_type (struct compile_process *process, int node)
+{
+  return process->ast->type[node];
+}
+
+int
+node_flags (struct compile_process *process, int node)
+{
+  return process->ast->flags[node] & ~AST_FLAG_BIG_NUMBER;
+}
+
+void
+node_set_flags (struct compile_process *process, int node, int flags)
+{
+  process->ast->flags[node] |= flags;
+}
+
+unsigned int
+node_offset (struct compile_process *process, int node)
+{
+  return process->ast->offset[node];
+}
+
+int
+node_parentheses_exp (struct compile_process *process, int node)
+{
+  assert (node_type (process, node) == NODE_TYPE_EXPRESSION_PARENTHESES);
+  return process->ast->data[node];
+}
+
+const char *
+node_sval (struct compile_process *process, int node)
+{
+  assert (node_type (process, node) == NODE_TYPE_IDENTIFIER
+          || node_type (process, node) == NODE_TYPE_STRING);
+  return intern_get (process->ast->strings, process->ast->data[node]);
+}
+
+unsigned long long
+node_llnum (struct compile_process *process, int node)
+{
+  struct node_number *number = ast_big_number (process->ast, node);
+  return number ? number->llnum : process->ast->data[node];
+}
+
+double
+node_dval (struct compile_process *process, int node)
+{
+  struct node_number *number = ast_big_number (process->ast, node);
+  return number ? number->dval : process->ast->data[node];
+}
+
+int
+node_number_type (struct compile_process *process, int node)
+{
+  struct node_number *number = ast_big_number (process->ast, node);
+  return number ? number->num.type : NUMBER_TYPE_NORMAL;
+}
+
+int
+node_number_flags (struct compile_process *process, int node)
+{
+  struct node_number *number = ast_big_number (process->ast, node);
+  return number ? number->num.flags : 0;
+}
+
+struct node_exp *
+node_exp (struct compile_process *process, int node)
+{
+  assert (node_type (process, node) == NODE_TYPE_EXPRESSION);
+  return vector_at (process->ast->exps, process->ast->data[node]);
+}
+
+struct node_var *
+node_var (struct compile_process *process, int node)
+{
+  assert (node_type (process, node) == NODE_TYPE_VARIABLE);
+  return vector_at (process->ast->vars, process->ast->data[node]);
+}
+
+const struct datatype *
+node_var_type (struct compile_process *process, int node)
+{
+  return datatype_get (process->datatypes, node_var (process, node)->type);
+}
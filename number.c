@@ -0,0 +1,442 @@
+/*
+ * number.c - Parses numeric literals.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include "compiler.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+
+// literals longer than this are copied to the heap to be given to strtod
+#define NUMBER_MAX_STACK_LITERAL 128
+
+// doubles hold integers up to 2^53 exactly, floats up to 2^24
+#define NUMBER_DOUBLE_MAX_EXACT (1ull << 53)
+#define NUMBER_FLOAT_MAX_EXACT (1ull << 24)
+
+// powers of ten that are exact as doubles (and as floats, up to 1e10)
+static const double number_powers_of_ten[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int
+number_digit_value (char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+
+  return 16;
+}
+
+size_t
+number_literal_length (const char *str, size_t len)
+{
+  // a "preprocessing number": digits, letters, dots and signs right after
+  // an exponent
+  size_t i = 0;
+  while (i < len)
+    {
+      char c = str[i];
+      if ((c == '+' || c == '-') && i > 0
+          && (str[i - 1] == 'e' || str[i - 1] == 'E' || str[i - 1] == 'p'
+              || str[i - 1] == 'P'))
+        {
+          i++;
+          continue;
+        }
+
+      if (!isalnum ((unsigned char)c) && c != '_' && c != '.')
+        break;
+
+      i++;
+    }
+
+  return i;
+}
+
+// parses the suffix of an integer, i.e. `ul' or `LLU'
+static int
+number_parse_integer_suffix (const char *str, size_t len,
+                             struct token_number *num)
+{
+  size_t i = 0;
+  _Bool is_unsigned = 0;
+  int type = NUMBER_TYPE_NORMAL;
+
+  if (i < len && (str[i] == 'u' || str[i] == 'U'))
+    {
+      is_unsigned = 1;
+      i++;
+    }
+
+  if (i < len && (str[i] == 'l' || str[i] == 'L'))
+    {
+      type = NUMBER_TYPE_LONG;
+
+      // `ll' and `LL', but not `lL'
+      if (i + 1 < len && str[i + 1] == str[i])
+        {
+          type = NUMBER_TYPE_LONG_LONG;
+          i++;
+        }
+
+      i++;
+    }
+
+  if (!is_unsigned && i > 0 && i < len && (str[i] == 'u' || str[i] == 'U'))
+    {
+      is_unsigned = 1;
+      i++;
+    }
+
+  if (i != len)
+    return NUMBER_PARSE_INVALID_SUFFIX;
+
+  num->type = type;
+  num->flags = is_unsigned ? NUMBER_FLAG_UNSIGNED : 0;
+  return NUMBER_PARSE_OK;
+}
+
+// the type of an integer literal is the first of int, long and long long
+// (starting at the one its suffix asks for) that can hold its value. Octal,
+// hex and binary literals may also take the unsigned version of each
+static void
+number_fit_integer_type (int base, unsigned long long value,
+                         struct token_number *num)
+{
+  static const int types[]
+      = { NUMBER_TYPE_NORMAL, NUMBER_TYPE_LONG, NUMBER_TYPE_LONG_LONG };
+
+  _Bool is_unsigned = num->flags & NUMBER_FLAG_UNSIGNED;
+  int i = num->type == NUMBER_TYPE_NORMAL ? 0
+          : num->type == NUMBER_TYPE_LONG ? 1
+                                          : 2;
+  for (; i < 3; i++)
+    {
+      int bits = number_integer_bits (types[i]);
+      unsigned long long unsigned_max = bits == 64 ? ULLONG_MAX : UINT_MAX;
+      unsigned long long signed_max = unsigned_max >> 1;
+      if (!is_unsigned && value <= signed_max)
+        break;
+
+      if ((is_unsigned || base != 10) && value <= unsigned_max)
+        {
+          is_unsigned = 1;
+          break;
+        }
+    }
+
+  // too large even for long long, C gives it no type but it does fit in an
+  // unsigned long long
+  if (i == 3)
+    {
+      i = 2;
+      is_unsigned = 1;
+    }
+
+  num->type = types[i];
+  num->flags = is_unsigned ? NUMBER_FLAG_UNSIGNED : 0;
+}
+
+// gives the literal to strtod or strtof, which always round correctly
+static double
+number_parse_float_slow (const char *str, size_t len, int type)
+{
+  char stack_copy[NUMBER_MAX_STACK_LITERAL];
+  char *copy = stack_copy;
+  if (len >= sizeof (stack_copy))
+    {
+      copy = malloc (len + 1);
+      assert (copy);
+    }
+
+  memcpy (copy, str, len);
+  copy[len] = 0x00;
+
+  double res = type == NUMBER_TYPE_FLOAT ? strtof (copy, NULL)
+                                         : strtod (copy, NULL);
+  if (copy != stack_copy)
+    free (copy);
+
+  return res;
+}
+
+// tries to work out `mantissa * 10^exponent' exactly with a single floating
+// point operation (Clinger's fast path). Returns 0 if that's not possible
+static _Bool
+number_parse_float_fast (unsigned long long mantissa, int exponent, int type,
+                         double *out)
+{
+  if (type == NUMBER_TYPE_FLOAT)
+    {
+      if (mantissa > NUMBER_FLOAT_MAX_EXACT || exponent < -10 || exponent > 10)
+        return 0;
+
+      float value = mantissa;
+      float power = number_powers_of_ten[exponent < 0 ? -exponent : exponent];
+      *out = exponent < 0 ? value / power : value * power;
+      return 1;
+    }
+
+  if (mantissa == 0)
+    {
+      *out = 0;
+      return 1;
+    }
+
+  if (mantissa > NUMBER_DOUBLE_MAX_EXACT || exponent < -22)
+    return 0;
+
+  double value = mantissa;
+  if (exponent > 22)
+    {
+      // i.e. 12e30, as long as 12e8 is still exact we can do 12e8 * 1e22
+      unsigned long long scaled = mantissa;
+      for (; exponent > 22; exponent--)
+        {
+          if (__builtin_mul_overflow (scaled, 10, &scaled)
+              || scaled > NUMBER_DOUBLE_MAX_EXACT)
+            return 0;
+        }
+
+      value = scaled;
+    }
+
+  double power = number_powers_of_ten[exponent < 0 ? -exponent : exponent];
+  *out = exponent < 0 ? value / power : value * power;
+  return 1;
+}
+
+// parses a decimal floating point literal, i.e. `1.5e-3f'
+static int
+number_parse_decimal_float (const char *str, size_t len,
+                            struct token_number *num, double *dval)
+{
+  unsigned long long mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+
+  // more significant digits than fit in the mantissa
+  _Bool truncated = 0;
+
+  size_t i = 0;
+  for (; i < len && isdigit ((unsigned char)str[i]); i++)
+    {
+      if (digits == 19)
+        {
+          truncated = 1;
+          exponent++;
+          continue;
+        }
+
+      mantissa = mantissa * 10 + (str[i] - '0');
+      digits += mantissa != 0;
+    }
+
+  if (i < len && str[i] == '.')
+    {
+      for (i++; i < len && isdigit ((unsigned char)str[i]); i++)
+        {
+          if (digits == 19)
+            {
+              truncated = 1;
+              continue;
+            }
+
+          mantissa = mantissa * 10 + (str[i] - '0');
+          digits += mantissa != 0;
+          exponent--;
+        }
+    }
+
+  if (i < len && (str[i] == 'e' || str[i] == 'E'))
+    {
+      i++;
+      int sign = 1;
+      if (i < len && (str[i] == '+' || str[i] == '-'))
+        {
+          sign = str[i] == '-' ? -1 : 1;
+          i++;
+        }
+
+      if (i == len || !isdigit ((unsigned char)str[i]))
+        return NUMBER_PARSE_INVALID;
+
+      int exp_value = 0;
+      for (; i < len && isdigit ((unsigned char)str[i]); i++)
+        {
+          // anything this big is going to be zero or infinity anyway
+          if (exp_value < 100000)
+            exp_value = exp_value * 10 + (str[i] - '0');
+        }
+
+      exponent += sign * exp_value;
+    }
+
+  size_t literal_len = i;
+  num->flags = 0;
+  num->type = NUMBER_TYPE_DOUBLE;
+  if (i < len && (str[i] == 'f' || str[i] == 'F'))
+    {
+      num->type = NUMBER_TYPE_FLOAT;
+      i++;
+    }
+  else if (i < len && (str[i] == 'l' || str[i] == 'L'))
+    {
+      num->type = NUMBER_TYPE_LONG_DOUBLE;
+      i++;
+    }
+
+  if (i != len)
+    return NUMBER_PARSE_INVALID_SUFFIX;
+
+  if (truncated
+      || !number_parse_float_fast (mantissa, exponent, num->type, dval))
+    {
+      *dval = number_parse_float_slow (str, literal_len, num->type);
+    }
+
+  return NUMBER_PARSE_OK;
+}
+
+// parses a hexadecimal floating point literal, i.e. `0x1.8p3'. These are
+// rare enough to always take the slow path
+static int
+number_parse_hex_float (const char *str, size_t len, struct token_number *num,
+                        double *dval)
+{
+  size_t i = 2;
+  while (i < len && (number_digit_value (str[i]) < 16 || str[i] == '.'))
+    i++;
+
+  // the binary exponent is mandatory
+  if (i == len || (str[i] != 'p' && str[i] != 'P'))
+    return NUMBER_PARSE_INVALID;
+
+  i++;
+  if (i < len && (str[i] == '+' || str[i] == '-'))
+    i++;
+
+  if (i == len || !isdigit ((unsigned char)str[i]))
+    return NUMBER_PARSE_INVALID;
+
+  while (i < len && isdigit ((unsigned char)str[i]))
+    i++;
+
+  size_t literal_len = i;
+  num->flags = 0;
+  num->type = NUMBER_TYPE_DOUBLE;
+  if (i < len && (str[i] == 'f' || str[i] == 'F'))
+    {
+      num->type = NUMBER_TYPE_FLOAT;
+      i++;
+    }
+  else if (i < len && (str[i] == 'l' || str[i] == 'L'))
+    {
+      num->type = NUMBER_TYPE_LONG_DOUBLE;
+      i++;
+    }
+
+  if (i != len)
+    return NUMBER_PARSE_INVALID_SUFFIX;
+
+  *dval = number_parse_float_slow (str, literal_len, num->type);
+  return NUMBER_PARSE_OK;
+}
+
+int
+number_parse (const char *str, size_t len, struct token *token)
+{
+  token->type = TOKEN_TYPE_NUMBER;
+
+  int base = 10;
+  size_t i = 0;
+  if (len > 1 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+    {
+      base = 16;
+      i = 2;
+    }
+  else if (len > 1 && str[0] == '0' && (str[1] == 'b' || str[1] == 'B'))
+    {
+      base = 2;
+      i = 2;
+    }
+  else if (str[0] == '0')
+    {
+      base = 8;
+    }
+
+  size_t digits_start = i;
+  unsigned long long value = 0;
+  _Bool overflow = 0;
+  for (; i < len; i++)
+    {
+      int digit = number_digit_value (str[i]);
+      if (digit >= (base == 16 ? 16 : 10))
+        break;
+
+      // octal and binary literals are checked once we know they aren't
+      // floats
+      if (__builtin_mul_overflow (value, base, &value)
+          || __builtin_add_overflow (value, digit, &value))
+        overflow = 1;
+    }
+
+  _Bool is_float = i < len
+                   && (str[i] == '.'
+                       || (base == 16 ? str[i] == 'p' || str[i] == 'P'
+                                      : str[i] == 'e' || str[i] == 'E'));
+  if (is_float)
+    {
+      token->num = (struct token_number){ 0 };
+      if (base == 16)
+        return number_parse_hex_float (str, len, &token->num, &token->dval);
+
+      if (base == 2)
+        return NUMBER_PARSE_INVALID;
+
+      return number_parse_decimal_float (str, len, &token->num, &token->dval);
+    }
+
+  if (i == digits_start)
+    return NUMBER_PARSE_INVALID;
+
+  for (size_t j = digits_start; j < i; j++)
+    {
+      if (number_digit_value (str[j]) >= base)
+        return NUMBER_PARSE_INVALID;
+    }
+
+  if (overflow)
+    return NUMBER_PARSE_TOO_LARGE;
+
+  token->llnum = value;
+  int res = number_parse_integer_suffix (str + i, len - i, &token->num);
+  if (res == NUMBER_PARSE_OK)
+    number_fit_integer_type (base, value, &token->num);
+
+  return res;
+}
+
+int
+number_integer_bits (int type)
+{
+  return type == NUMBER_TYPE_LONG_LONG ? 64 : 32;
+}
+
+_Bool
+number_is_float (int type)
+{
+  return type == NUMBER_TYPE_FLOAT || type == NUMBER_TYPE_DOUBLE
+         || type == NUMBER_TYPE_LONG_DOUBLE;
+}
@@ -0,0 +1,107 @@
+/*
+ * operator.c - Operator codes, their spelling and the DFA the lexer uses to
+ * read them.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include "compiler.h"
+
+static const char *operator_names[OPERATOR_TOTAL]
+    = { [OPERATOR_INCREMENT] = "++",
+        [OPERATOR_DECREMENT] = "--",
+        [OPERATOR_CALL] = "()",
+        [OPERATOR_SUBSCRIPT] = "[]",
+        [OPERATOR_LEFT_PARENTHESES] = "(",
+        [OPERATOR_LEFT_BRACKET] = "[",
+        [OPERATOR_DOT] = ".",
+        [OPERATOR_ARROW] = "->",
+        [OPERATOR_MULTIPLY] = "*",
+        [OPERATOR_DIVIDE] = "/",
+        [OPERATOR_MODULO] = "%",
+        [OPERATOR_PLUS] = "+",
+        [OPERATOR_MINUS] = "-",
+        [OPERATOR_LEFT_SHIFT] = "<<",
+        [OPERATOR_RIGHT_SHIFT] = ">>",
+        [OPERATOR_LESS] = "<",
+        [OPERATOR_LESS_EQUAL] = "<=",
+        [OPERATOR_GREATER] = ">",
+        [OPERATOR_GREATER_EQUAL] = ">=",
+        [OPERATOR_EQUAL] = "==",
+        [OPERATOR_NOT_EQUAL] = "!=",
+        [OPERATOR_BITWISE_AND] = "&",
+        [OPERATOR_BITWISE_XOR] = "^",
+        [OPERATOR_BITWISE_OR] = "|",
+        [OPERATOR_LOGICAL_AND] = "&&",
+        [OPERATOR_LOGICAL_OR] = "||",
+        [OPERATOR_QUESTION] = "?",
+        [OPERATOR_COLON] = ":",
+        [OPERATOR_ASSIGN] = "=",
+        [OPERATOR_ADD_ASSIGN] = "+=",
+        [OPERATOR_SUB_ASSIGN] = "-=",
+        [OPERATOR_MUL_ASSIGN] = "*=",
+        [OPERATOR_DIV_ASSIGN] = "/=",
+        [OPERATOR_MOD_ASSIGN] = "%=",
+        [OPERATOR_LEFT_SHIFT_ASSIGN] = "<<=",
+        [OPERATOR_RIGHT_SHIFT_ASSIGN] = ">>=",
+        [OPERATOR_AND_ASSIGN] = "&=",
+        [OPERATOR_XOR_ASSIGN] = "^=",
+        [OPERATOR_OR_ASSIGN] = "|=",
+        [OPERATOR_COMMA] = ",",
+        [OPERATOR_LOGICAL_NOT] = "!",
+        [OPERATOR_BITWISE_NOT] = "~",
+        [OPERATOR_ELLIPSIS] = "..." };
+
+// first character -> operator
+static const unsigned char operator_start_state[128]
+    = { ['+'] = OPERATOR_PLUS,        ['-'] = OPERATOR_MINUS,
+        ['*'] = OPERATOR_MULTIPLY,    ['/'] = OPERATOR_DIVIDE,
+        ['%'] = OPERATOR_MODULO,      ['!'] = OPERATOR_LOGICAL_NOT,
+        ['^'] = OPERATOR_BITWISE_XOR, ['~'] = OPERATOR_BITWISE_NOT,
+        ['>'] = OPERATOR_GREATER,     ['<'] = OPERATOR_LESS,
+        ['|'] = OPERATOR_BITWISE_OR,  ['&'] = OPERATOR_BITWISE_AND,
+        ['='] = OPERATOR_ASSIGN,      ['('] = OPERATOR_LEFT_PARENTHESES,
+        ['['] = OPERATOR_LEFT_BRACKET, [','] = OPERATOR_COMMA,
+        ['.'] = OPERATOR_DOT,         ['?'] = OPERATOR_QUESTION };
+
+// (operator read so far, next character) -> longer operator. Operators like
+// `*' or `(' are always read on their own, so they have no transitions.
+static const unsigned char operator_transitions[OPERATOR_TOTAL][128]
+    = { [OPERATOR_PLUS]
+        = { ['+'] = OPERATOR_INCREMENT, ['='] = OPERATOR_ADD_ASSIGN },
+        [OPERATOR_MINUS] = { ['-'] = OPERATOR_DECREMENT,
+                             ['='] = OPERATOR_SUB_ASSIGN,
+                             ['>'] = OPERATOR_ARROW },
+        [OPERATOR_DIVIDE] = { ['='] = OPERATOR_DIV_ASSIGN },
+        [OPERATOR_GREATER] = { ['>'] = OPERATOR_RIGHT_SHIFT,
+                               ['='] = OPERATOR_GREATER_EQUAL },
+        [OPERATOR_LESS]
+        = { ['<'] = OPERATOR_LEFT_SHIFT, ['='] = OPERATOR_LESS_EQUAL },
+        [OPERATOR_BITWISE_OR] = { ['|'] = OPERATOR_LOGICAL_OR },
+        [OPERATOR_BITWISE_AND] = { ['&'] = OPERATOR_LOGICAL_AND },
+        [OPERATOR_LOGICAL_NOT] = { ['='] = OPERATOR_NOT_EQUAL },
+        [OPERATOR_ASSIGN] = { ['='] = OPERATOR_EQUAL } };
+
+int
+operator_start (char c)
+{
+  if ((unsigned char)c >= 128)
+    return OPERATOR_NONE;
+
+  return operator_start_state[(unsigned char)c];
+}
+
+int
+operator_next (int op, char c)
+{
+  if ((unsigned char)c >= 128)
+    return OPERATOR_NONE;
+
+  return operator_transitions[op][(unsigned char)c];
+}
+
+const char *
+operator_name (int op)
+{
+  return operator_names[op];
+}
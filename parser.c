@@ -6,319 +6,460 @@
 
 #include "compiler.h"
 
-static struct compile_process *current_process;
-static struct token *parser_last_token;
-
-extern struct expressionable_op_precedence_group
-    op_precedence[TOTAL_OPERATOR_GROUPS];
-
 struct history
 {
   int flags;
 };
 
-struct history *
+// histories are small and only needed while parsing what they are for, so
+// they are passed around by value and live on the stack
+struct history
 history_begin (int flags)
 {
-  struct history *history = calloc (1, sizeof (struct history));
-  history->flags = flags;
-  return history;
+  return (struct history){ .flags = flags };
 }
 
-struct history *
+struct history
 history_down (struct history *history, int flags)
 {
-  struct history *new_history = calloc (1, sizeof (struct history));
-  memcpy (new_history, history, sizeof (struct history));
-  new_history->flags = flags; // overwrite flags
+  struct history new_history = *history;
+  new_history.flags = flags; // overwrite flags
   return new_history;
 }
 
-int parse_expressionable_single (struct history *history);
-void parse_expressionable (struct history *history);
+void parse_exp (struct compile_process *process, struct history *history);
+void parse_expressionable (struct compile_process *process,
+                           struct history *history);
 
 // this will ignore a newline or a comment
 static void
-parser_ignore_nl_or_comment (struct token *token)
+parser_ignore_nl_or_comment (struct compile_process *process)
 {
-  while (token && token_is_nl_or_comment_or_nl_separator (token))
+  struct token_stream *tokens = process->tokens;
+  if (tokens->significant_only)
+    return;
+
+  while (token_stream_ensure (tokens, tokens->cursor)
+         && token_is_nl_or_comment_or_nl_separator (tokens, tokens->cursor))
     {
       // skip the token
-      vector_peek (current_process->token_vec);
-      token = vector_peek_no_increment (current_process->token_vec);
+      tokens->cursor++;
     }
 }
 
-static struct token *
-token_next ()
+// tokens are indices into the token stream, -1 when we ran out of them
+static int
+token_next (struct compile_process *process)
 {
-  struct token *next_token
-      = vector_peek_no_increment (current_process->token_vec);
-  parser_ignore_nl_or_comment (next_token);
-  current_process->pos = next_token->pos;
-  parser_last_token = next_token;
-  return vector_peek (current_process->token_vec);
+  struct token_stream *tokens = process->tokens;
+  parser_ignore_nl_or_comment (process);
+  if (!token_stream_ensure (tokens, tokens->cursor))
+    return -1;
+
+  int next_token = tokens->cursor++;
+  process->offset = token_stream_offset (tokens, next_token);
+  process->parser.last_token = next_token;
+  return next_token;
 }
 
-static struct token *
-token_peek_next ()
+static int
+token_peek_next (struct compile_process *process)
 {
-  struct token *next_token
-      = vector_peek_no_increment (current_process->token_vec);
-  parser_ignore_nl_or_comment (next_token);
-  return vector_peek_no_increment (current_process->token_vec);
+  struct token_stream *tokens = process->tokens;
+  parser_ignore_nl_or_comment (process);
+  if (!token_stream_ensure (tokens, tokens->cursor))
+    return -1;
+
+  return tokens->cursor;
 }
 
 static _Bool
-token_next_is_operator (const char *op)
+token_next_is_operator (struct compile_process *process, int op)
+{
+  int tok = token_peek_next (process);
+  return token_is_operator (process->tokens, tok, op);
+}
+
+// type of `token', -1 for no token
+static int
+token_type (struct compile_process *process, int token)
+{
+  if (token < 0)
+    return -1;
+
+  return token_stream_type (process->tokens, token);
+}
+
+static const char *
+token_sval (struct compile_process *process, int token)
+{
+  if (token < 0)
+    return NULL;
+
+  return token_stream_sval (process->tokens, token);
+}
+
+static int
+token_keyword (struct compile_process *process, int token)
 {
-  struct token *tok = token_peek_next ();
-  return token_is_operator (tok, op);
+  if (token < 0)
+    return KEYWORD_NONE;
+
+  return token_stream_keyword (process->tokens, token);
 }
 
 void
-parse_single_token_to_node ()
+parse_single_token_to_node (struct compile_process *process)
 {
-  struct token *token = token_next ();
-  struct node *node = NULL;
+  int token = token_next (process);
+  unsigned int offset = process->offset;
 
-  switch (token->type)
+  switch (token_type (process, token))
     {
     case TOKEN_TYPE_NUMBER:
-      node = node_create (
-          &(struct node){ .type = NODE_TYPE_NUMBER, .llnum = token->llnum });
+      {
+        struct token_stream *tokens = process->tokens;
+        struct node node
+            = { .type = NODE_TYPE_NUMBER,
+                .offset = offset,
+                .num.type = token_stream_number_type (tokens, token),
+                .num.flags = token_stream_number_flags (tokens, token) };
+
+        if (number_is_float (node.num.type))
+          node.dval = token_stream_dval (tokens, token);
+        else
+          node.llnum = token_stream_llnum (tokens, token);
+
+        node_create (process, &node);
+      }
       break;
 
     case TOKEN_TYPE_IDENTIFIER:
-      node = node_create (
-          &(struct node){ .type = NODE_TYPE_IDENTIFIER, .sval = token->sval });
+      node_create (process,
+                   &(struct node){ .type = NODE_TYPE_IDENTIFIER,
+                                   .offset = offset,
+                                   .sval = token_sval (process, token) });
       break;
 
     case TOKEN_TYPE_STRING:
-      node = node_create (
-          &(struct node){ .type = NODE_TYPE_STRING, .sval = token->sval });
+      node_create (process,
+                   &(struct node){ .type = NODE_TYPE_STRING,
+                                   .offset = offset,
+                                   .sval = token_sval (process, token) });
       break;
 
     default:
       compiler_error (
-          current_process,
+          process,
           "This is not a single token that can be converted to a node");
       break;
     }
 }
 
 void
-parse_expressionable_for_op (struct history *history, const char *op)
+parse_identifier (struct compile_process *process, struct history *history)
 {
-  parse_expressionable (history);
+  assert (token_type (process, token_peek_next (process))
+          == TOKEN_TYPE_IDENTIFIER);
+  parse_single_token_to_node (process);
 }
 
 static int
 parser_get_precedence_for_op (
-    const char *op, struct expressionable_op_precedence_group **group_out)
+    int op, struct expressionable_op_precedence_group **group_out)
+{
+  return expressionable_op_precedence (op, group_out);
+}
+
+// the precedence group of `token' if it's a binary operator, -1 otherwise.
+// The first group is postfix operators, calls and such, none of them binary
+static int
+parser_binary_op_precedence (
+    struct compile_process *process, int token,
+    struct expressionable_op_precedence_group **group_out)
 {
-  *group_out = NULL;
-  for (int i = 0; i < TOTAL_OPERATOR_GROUPS; i++)
+  if (token_type (process, token) != TOKEN_TYPE_OPERATOR)
+    return -1;
+
+  int op = token_stream_op (process->tokens, token);
+  int precedence = parser_get_precedence_for_op (op, group_out);
+  return precedence > 0 ? precedence : -1;
+}
+
+// parses what can be at either side of a binary operator, other than an
+// expression between parentheses
+void
+parse_expressionable_operand (struct compile_process *process,
+                              struct history *history)
+{
+  switch (token_type (process, token_peek_next (process)))
     {
-      for (int j = 0; op_precedence[i].operators[j]; j++)
-        {
-          const char *_op = op_precedence[i].operators[j];
-          if (S_EQ (op, _op))
-            {
-              *group_out = &op_precedence[i];
-              return i;
-            }
-        }
+    case TOKEN_TYPE_NUMBER:
+    case TOKEN_TYPE_STRING:
+      parse_single_token_to_node (process);
+      return;
+
+    case TOKEN_TYPE_IDENTIFIER:
+      parse_identifier (process, history);
+      return;
     }
 
-  return -1;
+  compiler_error (process, "Expecting an expression");
 }
 
-static _Bool
-parser_left_op_has_priority (const char *op_left, const char *op_right)
+// the operator on top of the stack, NULL if the expression that starts at
+// `base' has none left
+static struct parser_exp_op *
+parser_exp_op_peek (struct compile_process *process, int base)
 {
-  struct expressionable_op_precedence_group *group_left = NULL;
-  struct expressionable_op_precedence_group *group_right = NULL;
+  if (vector_count (process->parser.exp_ops) <= base)
+    return NULL;
 
-  if (S_EQ (op_left, op_right))
-    {
-      // there's no priority, they are equal
-      return 0;
-    }
+  return vector_back (process->parser.exp_ops);
+}
 
-  int precedence_left = parser_get_precedence_for_op (op_left, &group_left);
-  int precedence_right = parser_get_precedence_for_op (op_right, &group_right);
+static struct node
+parser_number_node (struct compile_process *process, int node)
+{
+  struct node number = { .type = NODE_TYPE_NUMBER,
+                         .offset = node_offset (process, node),
+                         .num.type = node_number_type (process, node),
+                         .num.flags = node_number_flags (process, node) };
 
-  if (group_left->associativity == ASSOCIATIVITY_RIGHT_TO_LEFT)
-    {
-      // we can't handle this here
-      return 0;
-    }
+  if (number_is_float (number.num.type))
+    number.dval = node_dval (process, node);
+  else
+    number.llnum = node_llnum (process, node);
 
-  return precedence_left <= precedence_right;
+  return number;
 }
 
-void
-parser_node_shift_children_left (struct node *node)
+// turns `left' into the number `left op right' if both are numbers, `right'
+// is dropped. Returns 0 if they aren't or it can't be done
+static _Bool
+parser_fold_exp (struct compile_process *process, int node_left,
+                 int node_right, int op)
 {
-  assert (node->type == NODE_TYPE_EXPRESSION);
-  assert (node->exp.right->type == NODE_TYPE_EXPRESSION);
+  if (node_type (process, node_left) != NODE_TYPE_NUMBER
+      || node_type (process, node_right) != NODE_TYPE_NUMBER)
+    return 0;
 
-  const char *right_op = node->exp.right->exp.op;
-  struct node *new_exp_left_node = node->exp.left;
-  struct node *new_exp_right_node = node->exp.right->exp.left;
-  make_exp_node (new_exp_left_node, new_exp_right_node, node->exp.op);
+  struct node left = parser_number_node (process, node_left);
+  struct node right = parser_number_node (process, node_right);
+  struct node res = { .offset = left.offset };
+  if (!expressionable_fold (process, op, &left, &right, &res))
+    return 0;
 
-  struct node *new_left_operand = node_pop ();
-  struct node *new_right_operand = node->exp.right->exp.right;
-  node->exp.left = new_left_operand;
-  node->exp.right = new_right_operand;
-  node->exp.op = right_op;
+  // `right' goes first, so its payload is freed before `left' needs one
+  node_discard (process, node_right);
+  node_set_number (process, node_left, &res);
+  node_push (process, node_left);
+  return 1;
 }
 
-void
-parser_reorder_exp (struct node **node_out)
+// joins the two nodes on top with the operator on top
+static void
+parser_exp_reduce (struct compile_process *process)
 {
-  struct node *node = *node_out;
-  if (node->type != NODE_TYPE_EXPRESSION)
-    return;
+  struct parser_exp_op *top = vector_back (process->parser.exp_ops);
+  int op = top->op;
+  vector_pop (process->parser.exp_ops);
+
+  int node_right = node_pop (process);
+  int node_left = node_pop (process);
 
-  // no expressions, nothing to do
-  if (node->exp.left->type != NODE_TYPE_EXPRESSION && node->exp.right
-      && node->exp.right->type != NODE_TYPE_EXPRESSION)
+  // literals like 4 * 1024 + 16 never make it into the tree
+  if (parser_fold_exp (process, node_left, node_right, op))
     return;
+  node_set_flags (process, node_left, NODE_FLAG_INSIDE_EXPRESSION);
+  node_set_flags (process, node_right, NODE_FLAG_INSIDE_EXPRESSION);
+  make_exp_node (process, node_left, node_right, op);
+}
 
-  // 50 + e(50 * 20) for example
-  if (node->exp.left->type != NODE_TYPE_EXPRESSION
-      && node->exp.right->type == NODE_TYPE_EXPRESSION)
+// joins every operator until the open parentheses or the start of the
+// expression
+static void
+parser_exp_reduce_all (struct compile_process *process, int base)
+{
+  struct parser_exp_op *top;
+  while ((top = parser_exp_op_peek (process, base))
+         && top->op != OPERATOR_LEFT_PARENTHESES)
     {
-      const char *right_op = node->exp.right->exp.op;
-      if (parser_left_op_has_priority (node->exp.op, right_op))
-        {
-          parser_node_shift_children_left (node);
+      parser_exp_reduce (process);
+    }
+}
 
-          // reorder the ast
-          parser_reorder_exp (&node->exp.left);
-          parser_reorder_exp (&node->exp.right);
-        }
+// joins the operators that have to be done before `precedence' can take its
+// left operand: tighter ones, and those of the same group unless they
+// associate to the right, i.e. a = (b = c) but (a - b) - c
+static void
+parser_exp_reduce_for_precedence (struct compile_process *process, int base,
+                                  int precedence, int associativity)
+{
+  struct parser_exp_op *top;
+  while ((top = parser_exp_op_peek (process, base))
+         && top->op != OPERATOR_LEFT_PARENTHESES
+         && (top->precedence < precedence
+             || (top->precedence == precedence
+                 && associativity == ASSOCIATIVITY_LEFT_TO_RIGHT)))
+    {
+      parser_exp_reduce (process);
     }
 }
 
+static void
+parser_exp_push_op (struct compile_process *process, int token,
+                    int precedence)
+{
+  // pop off the operator or parentheses token
+  token_next (process);
+  struct parser_exp_op op
+      = { .op = token_stream_op (process->tokens, token),
+          .precedence = precedence,
+          .offset = process->offset };
+  vector_push (process->parser.exp_ops, &op);
+}
+
+/**
+ * Parses operands joined by binary operators, leaving a single node. This is
+ * the shunting-yard algorithm: operands go straight to the node vector,
+ * operators wait in `exp_ops' until one that binds looser (or a closing
+ * parentheses) comes, so 1 + 2 * 3 - 4 is (1 + (2 * 3)) - 4. Nothing here
+ * recurses, no matter how long or deeply nested the expression is
+ */
 void
-parse_exp_normal (struct history *history)
+parse_exp (struct compile_process *process, struct history *history)
 {
-  struct token *op_token = token_peek_next ();
-  const char *op = op_token->sval;
-  struct node *node_left = node_peek_expressionable_or_null ();
-  if (!node_left)
-    return;
-
-  // pop off the operator token
-  token_next ();
-
-  // pop off the left node
-  node_pop ();
-  node_left->flags |= NODE_FLAG_INSIDE_EXPRESSION;
-  parse_expressionable_for_op (history_down (history, history->flags), op);
+  history->flags |= NODE_FLAG_INSIDE_EXPRESSION;
 
-  struct node *node_right = node_pop ();
-  node_right->flags |= NODE_FLAG_INSIDE_EXPRESSION;
+  // operators below `base' belong to whoever called us
+  int base = vector_count (process->parser.exp_ops);
+  int open_parentheses = 0;
+  for (;;)
+    {
+      int token = token_peek_next (process);
+      if (token_is_operator (process->tokens, token,
+                             OPERATOR_LEFT_PARENTHESES))
+        {
+          parser_exp_push_op (process, token, -1);
+          open_parentheses++;
+          continue;
+        }
 
-  make_exp_node (node_left, node_right, op);
-  struct node *exp_node = node_pop ();
+      parse_expressionable_operand (process, history);
 
-  // reorder the expression
-  parser_reorder_exp (&exp_node);
+      // close as many parentheses as there are right after the operand
+      token = token_peek_next (process);
+      while (open_parentheses > 0
+             && token_is_symbol (process->tokens, token, ')'))
+        {
+          token_next (process);
+          parser_exp_reduce_all (process, base);
+
+          struct parser_exp_op *open = vector_back (process->parser.exp_ops);
+          unsigned int offset = open->offset;
+          vector_pop (process->parser.exp_ops);
+          open_parentheses--;
+
+          // parentheses around a number don't change what it means, so
+          // it's left as it is and can be folded further
+          int exp_node = node_peek (process);
+          if (node_type (process, exp_node) != NODE_TYPE_NUMBER)
+            {
+              node_pop (process);
+              node_create (process,
+                           &(struct node){
+                               .type = NODE_TYPE_EXPRESSION_PARENTHESES,
+                               .offset = offset,
+                               .parenthesis.exp = exp_node });
+            }
 
-  node_push (exp_node);
-}
+          token = token_peek_next (process);
+        }
 
-int
-parse_exp (struct history *history)
-{
-  parse_exp_normal (history); // normal expressions like 50+20
+      struct expressionable_op_precedence_group *group = NULL;
+      int precedence = parser_binary_op_precedence (process, token, &group);
+      if (precedence < 0)
+        break;
 
-  return 0;
-}
+      parser_exp_reduce_for_precedence (process, base, precedence,
+                                        group->associativity);
+      parser_exp_push_op (process, token, precedence);
+    }
 
-void
-parse_identifier (struct history *history)
-{
-  assert (token_peek_next ()->type == NODE_TYPE_IDENTIFIER);
-  parse_single_token_to_node ();
-}
+  if (open_parentheses > 0)
+    compiler_error (process, "Expecting a closing parentheses");
 
-static _Bool
-is_keyword_variable_modifier (const char *val)
-{
-  return S_EQ (val, "unsigned") || S_EQ (val, "signed") || S_EQ (val, "static")
-         || S_EQ (val, "const") || S_EQ (val, "extern")
-         || S_EQ (val, "__ignore_typecheck");
+  parser_exp_reduce_all (process, base);
 }
 
 void
-parse_datatype_modifiers (struct datatype *dtype)
+parse_datatype_modifiers (struct compile_process *process,
+                          struct datatype *dtype)
 {
-  struct token *tok = token_peek_next ();
-  while (tok && tok->type == TOKEN_TYPE_KEYWORD)
+  int tok = token_peek_next (process);
+  while (token_type (process, tok) == TOKEN_TYPE_KEYWORD)
     {
-      if (!is_keyword_variable_modifier (tok->sval))
+      int keyword = token_keyword (process, tok);
+      if (!keyword_is_variable_modifier (keyword))
         break;
 
-      if (S_EQ (tok->sval, "signed"))
+      switch (keyword)
         {
+        case KEYWORD_SIGNED:
           dtype->flags |= DATATYPE_FLAG_IS_SIGNED;
-        }
-      else if (S_EQ (tok->sval, "unsigned"))
-        {
+          break;
+
+        case KEYWORD_UNSIGNED:
           dtype->flags &= ~DATATYPE_FLAG_IS_SIGNED;
-        }
-      else if (S_EQ (tok->sval, "static"))
-        {
+          break;
+
+        case KEYWORD_STATIC:
           dtype->flags |= DATATYPE_FLAG_IS_STATIC;
-        }
-      else if (S_EQ (tok->sval, "const"))
-        {
+          break;
+
+        case KEYWORD_CONST:
           dtype->flags |= DATATYPE_FLAG_IS_CONST;
-        }
-      else if (S_EQ (tok->sval, "extern"))
-        {
+          break;
+
+        case KEYWORD_EXTERN:
           dtype->flags |= DATATYPE_FLAG_IS_EXTERN;
-        }
-      else if (S_EQ (tok->sval, "__ignore_typecheck"))
-        {
+          break;
+
+        case KEYWORD_IGNORE_TYPECHECK:
           dtype->flags |= DATATYPE_FLAG_IGNORE_TYPE_CHECKING;
+          break;
         }
 
-      token_next ();
-      tok = token_peek_next ();
+      token_next (process);
+      tok = token_peek_next (process);
     }
 }
 
 void
-parser_get_datatype_tokens (struct token **dtype_tok,
-                            struct token **dtype_sec_tok)
+parser_get_datatype_tokens (struct compile_process *process, int *dtype_tok,
+                            int *dtype_sec_tok)
 {
-  *dtype_tok = token_next ();
-  struct token *next = token_peek_next ();
+  *dtype_tok = token_next (process);
+  int next = token_peek_next (process);
 
-  if (token_is_primitive_keyword (next))
+  if (token_is_primitive_keyword (process->tokens, next))
     {
       *dtype_sec_tok = next;
-      token_next ();
+      token_next (process);
     }
 }
 
 int
-parser_datatype_expected_for_type_string (const char *str)
+parser_datatype_expected_for_keyword (int keyword)
 {
   int type = DATA_TYPE_EXPECT_PRIMITIVE;
 
-  if (S_EQ (str, "union"))
+  if (keyword == KEYWORD_UNION)
     {
       type = DATA_TYPE_EXPECT_UNION;
     }
-  else if (S_EQ (str, "struct"))
+  else if (keyword == KEYWORD_STRUCT)
     {
       type = DATA_TYPE_EXPECT_STRUCT;
     }
@@ -327,37 +468,29 @@ parser_datatype_expected_for_type_string (const char *str)
 }
 
 int
-parser_get_random_type_index ()
+parser_get_random_type_index (struct compile_process *process)
 {
   // not actually random hehehe
-  static int x = 0;
-  x++;
-  return x;
+  return ++process->parser.random_type_index;
 }
 
-struct token *
-parser_build_random_type_name ()
+const char *
+parser_build_random_type_name (struct compile_process *process)
 {
-  char tmp_name[23] = { 0 };
-  sprintf (tmp_name, "customtypename_%d", parser_get_random_type_index ());
-  char *sval = malloc (sizeof (tmp_name));
-  strncpy (sval, tmp_name, sizeof (tmp_name));
-
-  struct token *tok = calloc (1, sizeof (struct token));
-  tok->type = TOKEN_TYPE_IDENTIFIER;
-  tok->sval = sval;
-
-  return tok;
+  char tmp_name[27] = { 0 };
+  sprintf (tmp_name, "customtypename_%d",
+           parser_get_random_type_index (process));
+  return intern_cstr (process->strings, tmp_name);
 }
 
 int
-parser_get_pointer_depth ()
+parser_get_pointer_depth (struct compile_process *process)
 {
   int depth = 0;
-  while (token_next_is_operator ("*"))
+  while (token_next_is_operator (process, OPERATOR_MULTIPLY))
     {
       depth++;
-      token_next ();
+      token_next (process);
     }
   return depth;
 }
@@ -369,181 +502,192 @@ parser_datatype_is_secondary_allowed (int expected_type)
 }
 
 _Bool
-parser_datatype_is_secondary_allowed_for_type (const char *type)
+parser_datatype_is_secondary_allowed_for_type (int keyword)
 {
-  return S_EQ (type, "long") || S_EQ (type, "short") || S_EQ (type, "double")
-         || S_EQ (type, "float");
+  return keyword == KEYWORD_LONG || keyword == KEYWORD_SHORT
+         || keyword == KEYWORD_DOUBLE || keyword == KEYWORD_FLOAT;
 }
 
 void parser_datatype_init_type_and_size_for_primitive (
-    struct token *dtype_token, struct token *dtype_sec_token,
+    struct compile_process *process, int keyword, int sec_keyword,
     struct datatype *dtype_out);
 
 void
-parser_datatype_adjust_size_for_secondary (struct datatype *dtype,
-                                           struct token *dtype_sec_token)
+parser_datatype_adjust_size_for_secondary (struct compile_process *process,
+                                           struct datatype *dtype,
+                                           int sec_keyword)
 {
-  if (!dtype_sec_token)
+  if (sec_keyword == KEYWORD_NONE)
     return;
 
-  struct datatype *sec_datatype = calloc (1, sizeof (struct datatype));
-  parser_datatype_init_type_and_size_for_primitive (dtype_sec_token, NULL,
-                                                    sec_datatype);
-  dtype->size += sec_datatype->size;
-  dtype->secondary = sec_datatype;
+  struct datatype sec_datatype = { 0 };
+  parser_datatype_init_type_and_size_for_primitive (
+      process, sec_keyword, KEYWORD_NONE, &sec_datatype);
+  dtype->size += sec_datatype.size;
+  int sec_id = datatype_intern (process->datatypes, &sec_datatype);
+  dtype->secondary = datatype_get (process->datatypes, sec_id);
   dtype->flags |= DATATYPE_FLAG_IS_SECONDARY;
 }
 
 void
 parser_datatype_init_type_and_size_for_primitive (
-    struct token *dtype_token, struct token *dtype_sec_token,
+    struct compile_process *process, int keyword, int sec_keyword,
     struct datatype *dtype_out)
 {
-  if (!parser_datatype_is_secondary_allowed_for_type (dtype_token->sval)
-      && dtype_sec_token)
+  if (!parser_datatype_is_secondary_allowed_for_type (keyword)
+      && sec_keyword != KEYWORD_NONE)
     {
-      compiler_error (current_process,
+      compiler_error (process,
                       "You are not allowed a secondary "
                       "datatype here for the given datatype `%s'",
-                      dtype_token->sval);
+                      keyword_name (keyword));
     }
 
-  if (S_EQ (dtype_token->sval, "void"))
+  switch (keyword)
     {
+    case KEYWORD_VOID:
       dtype_out->type = DATA_TYPE_VOID;
       dtype_out->size = DATA_SIZE_ZERO;
-    }
-  else if (S_EQ (dtype_token->sval, "char"))
-    {
+      break;
+
+    case KEYWORD_CHAR:
       dtype_out->type = DATA_TYPE_CHAR;
       dtype_out->size = DATA_SIZE_BYTE;
-    }
-  else if (S_EQ (dtype_token->sval, "short"))
-    {
+      break;
+
+    case KEYWORD_SHORT:
       dtype_out->type = DATA_TYPE_SHORT;
       dtype_out->size = DATA_SIZE_WORD;
-    }
-  else if (S_EQ (dtype_token->sval, "int"))
-    {
+      break;
+
+    case KEYWORD_INT:
       dtype_out->type = DATA_TYPE_INTEGER;
       dtype_out->size = DATA_SIZE_DWORD;
-    }
-  else if (S_EQ (dtype_token->sval, "long"))
-    {
+      break;
+
+    case KEYWORD_LONG:
       dtype_out->type = DATA_TYPE_LONG;
       dtype_out->size = DATA_SIZE_DWORD;
-    }
-  else if (S_EQ (dtype_token->sval, "float"))
-    {
+      break;
+
+    case KEYWORD_FLOAT:
       dtype_out->type = DATA_TYPE_FLOAT;
       dtype_out->size = DATA_SIZE_DWORD;
-    }
-  else if (S_EQ (dtype_token->sval, "double"))
-    {
+      break;
+
+    case KEYWORD_DOUBLE:
       dtype_out->type = DATA_TYPE_DOUBLE;
       dtype_out->size = DATA_SIZE_DWORD;
-    }
-  else
-    {
-      compiler_error (current_process, "Invalid primitive datatype");
+      break;
+
+    default:
+      compiler_error (process, "Invalid primitive datatype");
+      break;
     }
 
-  parser_datatype_adjust_size_for_secondary (dtype_out, dtype_sec_token);
+  parser_datatype_adjust_size_for_secondary (process, dtype_out, sec_keyword);
 }
 
 void
-parser_datatype_init_type_and_size (struct token *dtype_token,
-                                    struct token *dtype_sec_token,
+parser_datatype_init_type_and_size (struct compile_process *process,
+                                    int keyword, int sec_keyword,
                                     struct datatype *dtype_out,
                                     int pointer_depth, int expected_type)
 {
-  if (!parser_datatype_is_secondary_allowed (expected_type) && dtype_sec_token)
+  if (!parser_datatype_is_secondary_allowed (expected_type)
+      && sec_keyword != KEYWORD_NONE)
     {
-      compiler_error (current_process,
-                      "You provided an invalid secondary datatype");
+      compiler_error (process, "You provided an invalid secondary datatype");
     }
 
   switch (expected_type)
     {
     case DATA_TYPE_EXPECT_PRIMITIVE:
       parser_datatype_init_type_and_size_for_primitive (
-          dtype_token, dtype_sec_token, dtype_out);
+          process, keyword, sec_keyword, dtype_out);
       break;
 
     case DATA_TYPE_EXPECT_UNION:
     case DATA_TYPE_EXPECT_STRUCT:
-      compiler_error (current_process,
+      compiler_error (process,
                       "Structures and unions are not yet implemented :'c");
       break;
 
     default:
-      compiler_error (current_process, "Unknown datatype expectation");
+      compiler_error (process, "Unknown datatype expectation");
       break;
     }
 }
 
 void
-parser_datatype_init (struct token *dtype_token, struct token *dtype_sec_token,
+parser_datatype_init (struct compile_process *process, int keyword,
+                      int sec_keyword, const char *type_str,
                       struct datatype *dtype_out, int pointer_depth,
                       int expected_type)
 {
-  parser_datatype_init_type_and_size (dtype_token, dtype_sec_token, dtype_out,
-                                      pointer_depth, expected_type);
+  parser_datatype_init_type_and_size (process, keyword, sec_keyword,
+                                      dtype_out, pointer_depth, expected_type);
 
-  dtype_out->type_str = dtype_token->sval;
-  if (S_EQ (dtype_token->sval, "long") && dtype_sec_token
-      && S_EQ (dtype_sec_token->sval, "long"))
+  dtype_out->type_str = type_str;
+  if (keyword == KEYWORD_LONG && sec_keyword == KEYWORD_LONG)
     {
-      compiler_warning (current_process, "Kcc does not support 64 bit longs, "
-                                         "your long long will be 32 bits :D");
+      compiler_warning (process, "Kcc does not support 64 bit longs, "
+                                 "your long long will be 32 bits :D");
       dtype_out->size = DATA_SIZE_DWORD;
     }
 }
 
 void
-parse_datatype_type (struct datatype *dtype)
+parse_datatype_type (struct compile_process *process, struct datatype *dtype)
 {
-  struct token *dtype_tok = NULL;
-  struct token *dtype_sec_tok = NULL; // secondary
-  parser_get_datatype_tokens (&dtype_tok, &dtype_sec_tok);
+  int dtype_tok = -1;
+  int dtype_sec_tok = -1; // secondary
+  parser_get_datatype_tokens (process, &dtype_tok, &dtype_sec_tok);
 
-  int expected_type
-      = parser_datatype_expected_for_type_string (dtype_tok->sval);
+  // the stars after the type can take any number of tokens, which may be
+  // more than a streamed token stream keeps behind the parser, so nothing
+  // is read from these tokens after them
+  int keyword = token_keyword (process, dtype_tok);
+  int sec_keyword = token_keyword (process, dtype_sec_tok);
+  int expected_type = parser_datatype_expected_for_keyword (keyword);
+  const char *type_str = token_sval (process, dtype_tok);
 
-  if (datatype_is_struct_or_union_for_name (dtype_tok->sval))
+  if (datatype_is_struct_or_union_for_keyword (keyword))
     {
-      if (token_peek_next ()->type == TOKEN_TYPE_IDENTIFIER)
+      if (token_type (process, token_peek_next (process))
+          == TOKEN_TYPE_IDENTIFIER)
         {
           // change datatype token, i.e. from struct to struct_name
-          dtype_tok = token_next ();
+          dtype_tok = token_next (process);
+          type_str = token_sval (process, dtype_tok);
         }
       else
         {
           // structure without name
           // i.e.
           // struct { } abc;
-          dtype_tok = parser_build_random_type_name ();
+          type_str = parser_build_random_type_name (process);
           dtype->flags |= DATATYPE_FLAG_STRUCT_UNION_NO_NAME;
         }
     }
 
-  int pointer_depth = parser_get_pointer_depth ();
-  parser_datatype_init (dtype_tok, dtype_sec_tok, dtype, pointer_depth,
-                        expected_type);
+  int pointer_depth = parser_get_pointer_depth (process);
+  parser_datatype_init (process, keyword, sec_keyword, type_str, dtype,
+                        pointer_depth, expected_type);
 }
 
 void
-parse_datatype (struct datatype *dtype)
+parse_datatype (struct compile_process *process, struct datatype *dtype)
 {
   memset (dtype, 0, sizeof (struct datatype));
   dtype->flags |= DATATYPE_FLAG_IS_SIGNED; // signed by default
 
-  parse_datatype_modifiers (dtype);
-  parse_datatype_type (dtype);
+  parse_datatype_modifiers (process, dtype);
+  parse_datatype_type (process, dtype);
 
   // in case there are modifiers after the type
   // i.e. const char * const
-  parse_datatype_modifiers (dtype);
+  parse_datatype_modifiers (process, dtype);
 }
 
 _Bool
@@ -554,209 +698,247 @@ parser_is_int_valid_after_datatype (struct datatype *dtype)
 }
 
 void
-parser_ignore_int (struct datatype *dtype)
+parser_ignore_int (struct compile_process *process, struct datatype *dtype)
 {
   // ignores int on cases like `long int'
-  if (!token_is_keyword (token_peek_next (), "int"))
+  if (!token_is_keyword (process->tokens, token_peek_next (process),
+                         KEYWORD_INT))
     return;
 
   if (!parser_is_int_valid_after_datatype (dtype))
     {
-      compiler_error (current_process, "Int is not valid secondary datatype");
+      compiler_error (process, "Int is not valid secondary datatype");
     }
 
   // ignore the int token
-  token_next ();
+  token_next (process);
 }
 
 void
-parse_expressionable_root (struct history *history)
+parse_expressionable_root (struct compile_process *process,
+                           struct history *history)
 {
-  parse_expressionable (history);
+  parse_expressionable (process, history);
 
-  struct node *result_node = node_pop ();
-  // TODO: Literal sum
-  node_push (result_node);
+  int result_node = node_pop (process);
+  node_push (process, result_node);
 }
 
 void
-make_variable_node (struct datatype *dtype, struct token *name_token,
-                    struct node *value_node)
+make_variable_node (struct compile_process *process, struct datatype *dtype,
+                    int name_token, int value_node)
 {
   const char *name_str = NULL;
-  if (name_token)
+  unsigned int offset = process->offset;
+  if (name_token >= 0)
     {
-      name_str = name_token->sval;
+      name_str = token_sval (process, name_token);
+      offset = token_stream_offset (process->tokens, name_token);
     }
 
-  node_create (&(struct node){ .type = NODE_TYPE_VARIABLE,
-                               .var.name = name_str,
-                               .var.val = value_node,
-                               .var.type = *dtype });
+  int type = datatype_intern (process->datatypes, dtype);
+  node_create (process, &(struct node){ .type = NODE_TYPE_VARIABLE,
+                                        .offset = offset,
+                                        .var = { .type = type,
+                                                 .name = name_str,
+                                                 .val = value_node } });
 }
 
 void
-make_variable_node_and_register (struct history *history,
-                                 struct datatype *dtype,
-                                 struct token *name_token,
-                                 struct node *value_node)
+make_variable_node_and_register (struct compile_process *process,
+                                 struct history *history,
+                                 int var_node)
 {
-  make_variable_node (dtype, name_token, value_node);
-  struct node *var_node = node_pop ();
-
 #warning "do all the stuff pendant in `make_variable_node_and_register'"
 
   // TODO: calculate the scope offset
 
   // TODO: Push variable node to scope
 
-  node_push (var_node);
+  node_push (process, var_node);
 }
 
 void
-parse_variable (struct datatype *dtype, struct token *name_token,
-                struct history *history)
+parse_variable (struct compile_process *process, struct datatype *dtype,
+                int name_token, struct history *history)
 {
-  struct node *value_node = NULL;
-
 // TODO: Check for array brackets
 #warning "TODO: Array brackets"
 
+  // the node is made while the name token is still around, the value can
+  // take any number of tokens
+  make_variable_node (process, dtype, name_token, -1);
+  int var_node = node_pop (process);
+
   // parse something like `int c = 50'
-  if (token_next_is_operator ("="))
+  if (token_next_is_operator (process, OPERATOR_ASSIGN))
     {
       // ignore the eq operator
-      token_next ();
-      parse_expressionable_root (history);
-      value_node = node_pop ();
+      token_next (process);
+      parse_expressionable_root (process, history);
+      int value_node = node_pop (process);
+      node_var (process, var_node)->val = value_node;
     }
 
-  make_variable_node_and_register (history, dtype, name_token, value_node);
+  make_variable_node_and_register (process, history, var_node);
 }
 
 void
-parse_variable_function_or_struct_union (struct history *history)
+parse_variable_function_or_struct_union (struct compile_process *process,
+                                         struct history *history)
 {
   struct datatype dtype;
-  parse_datatype (&dtype);
+  parse_datatype (process, &dtype);
 
   // ignore ints if necessary
-  parser_ignore_int (&dtype);
+  parser_ignore_int (process, &dtype);
 
-  struct token *name_token = token_next ();
-  if (name_token->type != TOKEN_TYPE_IDENTIFIER)
+  int name_token = token_next (process);
+  if (token_type (process, name_token) != TOKEN_TYPE_IDENTIFIER)
     {
-      compiler_error (current_process, "Expecting a valid identifier name");
+      compiler_error (process, "Expecting a valid identifier name");
     }
 
   // TODO: check if this is a function declaration
-  parse_variable (&dtype, name_token, history);
+  parse_variable (process, &dtype, name_token, history);
 }
 
 void
-parse_keyword (struct history *history)
+parse_keyword (struct compile_process *process, struct history *history)
 {
-  struct token *tok = token_peek_next ();
+  int keyword = token_keyword (process, token_peek_next (process));
 
-  if (is_keyword_variable_modifier (tok->sval)
-      || keyword_is_datatype (tok->sval))
+  if (keyword_is_variable_modifier (keyword) || keyword_is_datatype (keyword))
     {
       // parsing a variable, a structure, a function or union
-      parse_variable_function_or_struct_union (history);
+      parse_variable_function_or_struct_union (process, history);
       return;
     }
 }
 
+void
+parse_expressionable (struct compile_process *process, struct history *history)
+{
+  parse_exp (process, history);
+}
+
+void
+parse_keyword_for_global (struct compile_process *process)
+{
+  struct history history = history_begin (0);
+  parse_keyword (process, &history);
+  int node = node_pop (process);
+
+  node_push (process, node);
+}
+
 int
-parse_expressionable_single (struct history *history)
+parse_next (struct compile_process *process)
 {
-  struct token *token = token_peek_next ();
-  if (!token)
+  int token = token_peek_next (process);
+  if (token < 0)
     return -1;
 
-  history->flags |= NODE_FLAG_INSIDE_EXPRESSION;
-  int res = -1;
+  int res = 0;
+  struct history history = history_begin (0);
 
-  switch (token->type)
+  switch (token_type (process, token))
     {
     case TOKEN_TYPE_NUMBER:
-      parse_single_token_to_node ();
-      res = 0;
-      break;
-
     case TOKEN_TYPE_IDENTIFIER:
-      parse_identifier (history);
-      res = 0;
-      break;
-
+    case TOKEN_TYPE_STRING:
     case TOKEN_TYPE_OPERATOR:
-      parse_exp (history);
-      res = 0;
+      parse_expressionable (process, &history);
       break;
 
     case TOKEN_TYPE_KEYWORD:
-      parse_keyword (history);
-      res = 0;
+      parse_keyword_for_global (process);
       break;
     }
 
   return res;
 }
 
-void
-parse_expressionable (struct history *history)
+// names bound in every scope, there are none before the root is created
+static int
+parser_bindings_count (struct compile_process *process)
 {
-  while (parse_expressionable_single (history) == 0)
-    {
-    }
+  return process->scope.bindings ? vector_count (process->scope.bindings)
+                                 : 0;
 }
 
+// everything parsed after a checkpoint sits past the marks it takes, so
+// going back is just cutting the vectors, the token stream and the arena at
+// those marks; nothing has to be walked or freed one by one
 void
-parse_keyword_for_global ()
-{
-  parse_keyword (history_begin (0));
-  struct node *node = node_pop ();
-
-  node_push (node);
+parser_checkpoint (struct compile_process *process,
+                   struct parser_checkpoint *checkpoint)
+{
+  token_stream_save (process->tokens);
+  *checkpoint = (struct parser_checkpoint){
+    .last_token = process->parser.last_token,
+    .nodes = vector_count (process->node_vec),
+    .tree_nodes = vector_count (process->node_tree_vec),
+    .exp_ops = vector_count (process->parser.exp_ops),
+    .ast = ast_mark (process->ast),
+    .datatypes = vector_count (process->datatypes->types),
+    .arena = arena_mark (process->arena),
+    .node_floor = process->parser.node_floor,
+    .scope = process->scope.current,
+    .bindings = parser_bindings_count (process),
+    .symbols = process->symbols.table,
+    .symbols_count = process->symbols.table->count,
+    .symbol_tables = vector_count (process->symbols.tables),
+  };
+
+  process->parser.node_floor = checkpoint->nodes;
 }
 
-int
-parse_next ()
+void
+parser_rollback (struct compile_process *process,
+                 struct parser_checkpoint *checkpoint)
 {
-  struct token *token = token_peek_next ();
-  if (!token)
-    return -1;
+  // scopes and symbols come from the arena too, cutting it under any that
+  // were made since the checkpoint would leave them dangling
+  assert (process->scope.current == checkpoint->scope);
+  assert (parser_bindings_count (process) == checkpoint->bindings);
+  assert (process->symbols.table == checkpoint->symbols);
+  assert (process->symbols.table->count == checkpoint->symbols_count);
+  assert (vector_count (process->symbols.tables)
+          == checkpoint->symbol_tables);
+  assert (vector_count (process->node_vec) >= checkpoint->nodes);
 
-  int res = 0;
+  process->parser.node_floor = checkpoint->node_floor;
+  token_stream_restore (process->tokens);
+  process->parser.last_token = checkpoint->last_token;
 
-  switch (token->type)
-    {
-    case TOKEN_TYPE_NUMBER:
-    case TOKEN_TYPE_IDENTIFIER:
-    case TOKEN_TYPE_STRING:
-      parse_expressionable (history_begin (0));
-      break;
+  vector_truncate (process->node_vec, checkpoint->nodes);
+  vector_truncate (process->node_tree_vec, checkpoint->tree_nodes);
+  vector_truncate (process->parser.exp_ops, checkpoint->exp_ops);
 
-    case TOKEN_TYPE_KEYWORD:
-      parse_keyword_for_global ();
-      break;
-    }
+  ast_rewind (process->ast, checkpoint->ast);
+  datatypes_truncate (process->datatypes, checkpoint->datatypes);
+  arena_rewind (process->arena, checkpoint->arena);
+}
 
-  return res;
+void
+parser_commit (struct compile_process *process,
+               struct parser_checkpoint *checkpoint)
+{
+  process->parser.node_floor = checkpoint->node_floor;
+  token_stream_save_purge (process->tokens);
 }
 
 int
 parse (struct compile_process *process)
 {
-  current_process = process;
-  parser_last_token = NULL;
+  process->parser.last_token = -1;
 
-  node_set_vector (process->node_vec, process->node_tree_vec);
-  struct node *node = NULL;
-  vector_set_peek_pointer (process->token_vec, 0);
-  while (parse_next () == 0)
+  int node = -1;
+  process->tokens->cursor = 0;
+  while (parse_next (process) == 0)
     {
-      node = node_peek ();
+      node = node_peek (process);
       vector_push (process->node_tree_vec, &node);
     }
 
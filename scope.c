@@ -6,20 +6,51 @@
 
 #include "compiler.h"
 
+// scopes come from the arena and are reused once they are finished, only
+// their entities have to be given back to the system
 struct scope *
-scope_alloc ()
+scope_alloc (struct compile_process *process, struct scope *parent)
 {
-  struct scope *scope = calloc (1, sizeof (struct scope));
-  scope->entities = vector_create (sizeof (void *));
+  struct scope *scope = process->scope.free_scopes;
+  if (scope)
+    {
+      process->scope.free_scopes = scope->parent;
+      vector_clear (scope->entities);
+    }
+  else
+    {
+      scope = arena_alloc (process->arena, sizeof (struct scope));
+      scope->entities = vector_create (sizeof (void *));
+      vector_set_flag (scope->entities, VECTOR_FLAG_PEEK_DECREMENT);
+    }
+
   vector_set_peek_pointer_end (scope->entities);
-  vector_set_flag (scope->entities, VECTOR_FLAG_PEEK_DECREMENT);
+  scope->flags = 0;
+  scope->size = 0;
+  scope->parent = parent;
+  scope->depth = parent ? parent->depth + 1 : 0;
+  scope->first_binding = vector_count (process->scope.bindings);
   return scope;
 }
 
+// unbinds every name bound in `scope', which must be the current one, and
+// keeps it for later
 void
-scope_dealloc (struct scope *scope)
+scope_dealloc (struct compile_process *process, struct scope *scope)
 {
-  // TODO: This
+  struct vector *bindings = process->scope.bindings;
+  while (vector_count (bindings) > scope->first_binding)
+    {
+      struct scope_binding *binding = vector_back_ptr (bindings);
+      vector_pop (bindings);
+
+      hashmap_set (process->scope.names, binding->name, binding->shadowed);
+      binding->shadowed = process->scope.free_bindings;
+      process->scope.free_bindings = binding;
+    }
+
+  scope->parent = process->scope.free_scopes;
+  process->scope.free_scopes = scope;
 }
 
 struct scope *
@@ -28,7 +59,14 @@ scope_create_root (struct compile_process *process)
   assert (!process->scope.root);
   assert (!process->scope.current);
 
-  struct scope *root_scope = scope_alloc ();
+  if (!process->scope.names)
+    {
+      process->scope.names = hashmap_create ();
+      process->scope.bindings
+          = vector_create (sizeof (struct scope_binding *));
+    }
+
+  struct scope *root_scope = scope_alloc (process, NULL);
   process->scope.root = root_scope;
   process->scope.current = root_scope;
   return root_scope;
@@ -37,9 +75,24 @@ scope_create_root (struct compile_process *process)
 void
 scope_free_root (struct compile_process *process)
 {
-  scope_dealloc (process->scope.root);
-  process->scope.root = NULL;
-  process->scope.current = NULL;
+  while (process->scope.current)
+    scope_finish (process);
+
+  // bindings live in the arena, everything else is ours
+  for (struct scope *scope = process->scope.free_scopes; scope;
+       scope = scope->parent)
+    vector_free (scope->entities);
+
+  if (process->scope.names)
+    {
+      hashmap_free (process->scope.names);
+      vector_free (process->scope.bindings);
+    }
+
+  process->scope.names = NULL;
+  process->scope.bindings = NULL;
+  process->scope.free_scopes = NULL;
+  process->scope.free_bindings = NULL;
 }
 
 struct scope *
@@ -48,9 +101,8 @@ scope_new (struct compile_process *process, int flags)
   assert (process->scope.root);
   assert (process->scope.current);
 
-  struct scope *new_scope = scope_alloc ();
+  struct scope *new_scope = scope_alloc (process, process->scope.current);
   new_scope->flags = flags;
-  new_scope->parent = process->scope.current;
   process->scope.current = new_scope;
 
   return new_scope;
@@ -129,11 +181,38 @@ scope_push (struct compile_process *process, void *ptr, size_t elm_size)
   process->scope.current->size += elm_size;
 }
 
+void
+scope_bind (struct compile_process *process, const char *name, void *entity)
+{
+  struct scope_binding *binding = process->scope.free_bindings;
+  if (binding)
+    process->scope.free_bindings = binding->shadowed;
+  else
+    binding = arena_alloc (process->arena, sizeof (struct scope_binding));
+
+  binding->name = name;
+  binding->entity = entity;
+  binding->depth = process->scope.current->depth;
+  binding->shadowed = hashmap_get (process->scope.names, name);
+
+  hashmap_set (process->scope.names, name, binding);
+  vector_push (process->scope.bindings, &binding);
+}
+
+struct scope_binding *
+scope_find (struct compile_process *process, const char *name)
+{
+  if (!process->scope.names)
+    return NULL;
+
+  return hashmap_get (process->scope.names, name);
+}
+
 void
 scope_finish (struct compile_process *process)
 {
   struct scope *new_current_scope = process->scope.current->parent;
-  scope_dealloc (process->scope.current);
+  scope_dealloc (process, process->scope.current);
 
   process->scope.current = new_current_scope;
   if (process->scope.root && !process->scope.current)
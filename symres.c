@@ -5,16 +5,27 @@
  */
 #include "compiler.h"
 
-static void
-symres_push_symbol (struct compile_process *process, struct symbol *sym)
+void
+symres_init (struct compile_process *process)
 {
-  vector_push (process->symbols.table, &sym);
+  process->symbols.tables = vector_create (sizeof (struct hashmap *));
+  process->symbols.spare_tables = vector_create (sizeof (struct hashmap *));
+  process->symbols.table = hashmap_create ();
 }
 
 void
-symres_init (struct compile_process *process)
+symres_free (struct compile_process *process)
 {
-  process->symbols.tables = vector_create (sizeof (struct vector *));
+  vector_push (process->symbols.tables, &process->symbols.table);
+  struct vector *all[] = { process->symbols.tables,
+                           process->symbols.spare_tables };
+  for (int i = 0; i < 2; i++)
+    {
+      for (int j = 0; j < vector_count (all[i]); j++)
+        hashmap_free (*(struct hashmap **)vector_at (all[i], j));
+
+      vector_free (all[i]);
+    }
 }
 
 void
@@ -23,14 +34,25 @@ symres_new_table (struct compile_process *process)
   // save the current table
   vector_push (process->symbols.tables, &process->symbols.table);
 
-  // overwrite the active table
-  process->symbols.table = vector_create (sizeof (struct symbol *));
+  // overwrite the active table, reusing one that was ended if we can
+  struct hashmap **spare = vector_back_or_null (process->symbols.spare_tables);
+  if (spare)
+    {
+      process->symbols.table = *spare;
+      vector_pop (process->symbols.spare_tables);
+      return;
+    }
+
+  process->symbols.table = hashmap_create ();
 }
 
 void
 symres_end_table (struct compile_process *process)
 {
-  struct vector *last_table = vector_back_ptr (process->symbols.tables);
+  hashmap_clear (process->symbols.table);
+  vector_push (process->symbols.spare_tables, &process->symbols.table);
+
+  struct hashmap *last_table = vector_back_ptr (process->symbols.tables);
   process->symbols.table = last_table;
   vector_pop (process->symbols.tables);
 }
@@ -38,19 +60,13 @@ symres_end_table (struct compile_process *process)
 struct symbol *
 symres_get_symbol (struct compile_process *process, const char *name)
 {
-  vector_set_peek_pointer (process->symbols.table, 0);
-  struct symbol *sym = vector_peek_ptr (process->symbols.table);
-  while (sym)
-    {
-      if (S_EQ (sym->name, name))
-        {
-          break;
-        }
-
-      sym = vector_peek_ptr (process->symbols.table);
-    }
+  // symbol names are interned when registered, a name that was never
+  // interned can't have a symbol
+  name = intern_find (process->strings, name, strlen (name));
+  if (!name)
+    return NULL;
 
-  return sym;
+  return hashmap_get (process->symbols.table, name);
 }
 
 struct symbol *
@@ -73,59 +89,56 @@ struct symbol *
 symres_register_symbol (struct compile_process *process, const char *sym_name,
                         int type, void *data)
 {
-  if (symres_get_symbol (process, sym_name))
+  const char *name = intern_cstr (process->strings, sym_name);
+  if (hashmap_get (process->symbols.table, name))
     return NULL;
 
-  struct symbol *sym = calloc (1, sizeof (struct symbol));
-  sym->name = sym_name;
+  struct symbol *sym = arena_alloc (process->arena, sizeof (struct symbol));
+  sym->name = name;
   sym->type = type;
   sym->data = data;
-  symres_push_symbol (process, sym);
+  hashmap_set (process->symbols.table, name, sym);
 
   return sym;
 }
 
-struct node *
+int
 sumres_node (struct symbol *sym)
 {
   if (sym->type != SYMBOL_TYPE_NODE)
-    return NULL;
+    return -1;
 
-  return sym->data;
+  return sym->node;
 }
 
 void
-symres_build_for_variable_node (struct compile_process *process,
-                                struct node *node)
+symres_build_for_variable_node (struct compile_process *process, int node)
 {
   compiler_error (process, "Variables are not supported yet :'c");
 }
 
 void
-symres_build_for_function_node (struct compile_process *process,
-                                struct node *node)
+symres_build_for_function_node (struct compile_process *process, int node)
 {
   compiler_error (process, "Functions are not supported yet :'c");
 }
 
 void
-symres_build_for_structure_node (struct compile_process *process,
-                                 struct node *node)
+symres_build_for_structure_node (struct compile_process *process, int node)
 {
   compiler_error (process, "Structures are not supported yet :'c");
 }
 
 void
-symres_build_for_union_node (struct compile_process *process,
-                             struct node *node)
+symres_build_for_union_node (struct compile_process *process, int node)
 {
   compiler_error (process, "Unions are not supported yet :'c");
 }
 
 void
-symres_build_for_node (struct compile_process *process, struct node *node)
+symres_build_for_node (struct compile_process *process, int node)
 {
-  switch (node->type)
+  switch (node_type (process, node))
     {
     case NODE_TYPE_VARIABLE:
       symres_build_for_variable_node (process, node);
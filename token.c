@@ -6,53 +6,47 @@
 
 #include "compiler.h"
 
-#define PRIMITIVE_TYPES_TOTAL 7
-const char *primitive_types[PRIMITIVE_TYPES_TOTAL]
-    = { "void", "char", "short", "int", "long", "float", "double" };
-
 _Bool
-token_is_keyword (struct token *token, const char *value)
+token_is_keyword (struct token_stream *stream, int token, int keyword)
 {
-  return token && token->type == TOKEN_TYPE_KEYWORD
-         && S_EQ (token->sval, value);
+  return token >= 0 && token_stream_keyword (stream, token) == keyword
+         && keyword != KEYWORD_NONE;
 }
 
 _Bool
-token_is_symbol (struct token *token, char c)
+token_is_symbol (struct token_stream *stream, int token, char c)
 {
-  return token && token->type == TOKEN_TYPE_SYMBOL && token->cval == c;
+  return token >= 0 && token_stream_type (stream, token) == TOKEN_TYPE_SYMBOL
+         && token_stream_cval (stream, token) == c;
 }
 
 _Bool
-token_is_operator (struct token *tok, const char *val)
+token_is_operator (struct token_stream *stream, int token, int op)
 {
-  return tok && tok->type == TOKEN_TYPE_OPERATOR && S_EQ (tok->sval, val);
+  return token >= 0 && token_stream_op (stream, token) == op
+         && op != OPERATOR_NONE;
 }
 
 _Bool
-token_is_nl_or_comment_or_nl_separator (struct token *token)
+token_is_nl_or_comment_or_nl_separator (struct token_stream *stream,
+                                        int token)
 {
-  if (!token)
+  if (token < 0)
     return 0;
 
-  return token->type == TOKEN_TYPE_NEWLINE || token->type == TOKEN_TYPE_COMMENT
-         || token_is_symbol (token, '\\');
+  int type = token_stream_type (stream, token);
+  return type == TOKEN_TYPE_NEWLINE || type == TOKEN_TYPE_COMMENT
+         || token_is_symbol (stream, token, '\\');
 }
 
 _Bool
-token_is_primitive_keyword (struct token *token)
+token_is_primitive_keyword (struct token_stream *stream, int token)
 {
-  if (!token)
+  if (token < 0)
     return 0;
 
-  if (token->type != TOKEN_TYPE_KEYWORD)
+  if (token_stream_type (stream, token) != TOKEN_TYPE_KEYWORD)
     return 0;
 
-  for (int i = 0; i < PRIMITIVE_TYPES_TOTAL; i++)
-    {
-      if (S_EQ (primitive_types[i], token->sval))
-        return 1;
-    }
-
-  return 0;
+  return keyword_is_primitive (token_stream_keyword (stream, token));
 }
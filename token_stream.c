@@ -0,0 +1,636 @@
+/*
+ * token_stream.c - Stores the tokens of a file as a structure of arrays.
+ *
+ * Copyright (C) 2022 walizw <yojan.bustamante@udea.edu.co>
+ */
+
+#include "compiler.h"
+#include "helpers/vector.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+#define TOKEN_STREAM_INITIAL_CAPACITY 1024
+
+// tokens right behind the parser are kept when streaming, it holds on to a
+// few of them after taking them (i.e. the name of a variable)
+#define TOKEN_STREAM_KEEP_BEHIND 64
+
+// slot of a token that's still available
+static int
+token_stream_slot (struct token_stream *stream, int token)
+{
+  assert (token >= stream->base && token < stream->count);
+  return token & stream->mask;
+}
+
+// copies `n' elements of `size' bytes from a ring into another one
+static void
+token_stream_copy_ring (void *dst, int dst_mask, const void *src, int src_mask,
+                        int from, int n, size_t size)
+{
+  for (int i = from; i < from + n; i++)
+    {
+      memcpy ((char *)dst + (i & dst_mask) * size,
+              (const char *)src + (i & src_mask) * size, size);
+    }
+}
+
+static void *
+token_stream_grow_ring (struct token_stream *stream, void *ring, int capacity,
+                        size_t size)
+{
+  void *new_ring = malloc (capacity * size);
+  assert (new_ring);
+  token_stream_copy_ring (new_ring, capacity - 1, ring, stream->mask,
+                          stream->base, stream->count - stream->base, size);
+  free (ring);
+  return new_ring;
+}
+
+static void
+token_stream_grow (struct token_stream *stream, int capacity)
+{
+  stream->kind = token_stream_grow_ring (stream, stream->kind, capacity,
+                                         sizeof (unsigned char));
+  stream->offset = token_stream_grow_ring (stream, stream->offset, capacity,
+                                           sizeof (unsigned int));
+  stream->len = token_stream_grow_ring (stream, stream->len, capacity,
+                                        sizeof (unsigned int));
+  stream->value = token_stream_grow_ring (stream, stream->value, capacity,
+                                          sizeof (unsigned int));
+  stream->capacity = capacity;
+  stream->mask = capacity - 1;
+}
+
+struct token_stream *
+token_stream_create (struct intern *strings)
+{
+  struct token_stream *stream = calloc (1, sizeof (struct token_stream));
+  stream->strings = strings;
+  stream->numbers = vector_create (sizeof (struct token_stream_number));
+  stream->brackets = vector_create (sizeof (struct token_brackets));
+  stream->saves = vector_create (sizeof (int));
+  token_stream_grow (stream, TOKEN_STREAM_INITIAL_CAPACITY);
+  return stream;
+}
+
+void
+token_stream_free (struct token_stream *stream)
+{
+  free (stream->kind);
+  free (stream->offset);
+  free (stream->len);
+  free (stream->value);
+  vector_free (stream->numbers);
+  vector_free (stream->brackets);
+  vector_free (stream->saves);
+  free (stream);
+}
+
+// forgets about the brackets before the first token we still have
+static void
+token_stream_recycle_brackets (struct token_stream *stream)
+{
+  unsigned int offset = stream->offset[stream->base & stream->mask];
+  int count = vector_count (stream->brackets);
+  while (stream->brackets_base < count)
+    {
+      struct token_brackets *brackets
+          = vector_at (stream->brackets, stream->brackets_base);
+      if (brackets->close >= offset)
+        break;
+
+      stream->brackets_base++;
+    }
+
+  // once most of them are gone, move the rest to a new vector
+  if (stream->brackets_base < TOKEN_STREAM_INITIAL_CAPACITY
+      || stream->brackets_base < count / 2)
+    return;
+
+  struct vector *brackets = vector_create (sizeof (struct token_brackets));
+  for (int i = stream->brackets_base; i < count; i++)
+    {
+      vector_push (brackets, vector_at (stream->brackets, i));
+    }
+
+  vector_free (stream->brackets);
+  stream->brackets = brackets;
+  stream->brackets_base = 0;
+}
+
+// forgets about the numbers of the tokens before the first one we still have
+static void
+token_stream_recycle_numbers (struct token_stream *stream)
+{
+  // numbers are pushed in the same order as their tokens, so the first one
+  // in use is the one of the first big number left
+  int count = vector_count (stream->numbers);
+  unsigned int first = stream->numbers_base + count;
+  for (int i = stream->base; i < stream->count; i++)
+    {
+      int slot = i & stream->mask;
+      if (stream->kind[slot] & TOKEN_KIND_BIG_NUMBER)
+        {
+          first = stream->value[slot];
+          break;
+        }
+    }
+
+  // once most of them are gone, move the rest to a new vector
+  int gone = first - stream->numbers_base;
+  if (gone < TOKEN_STREAM_INITIAL_CAPACITY || gone < count / 2)
+    return;
+
+  struct vector *numbers
+      = vector_create (sizeof (struct token_stream_number));
+  if (gone < count)
+    vector_push_multiple (numbers, vector_at (stream->numbers, gone),
+                          count - gone);
+
+  vector_free (stream->numbers);
+  stream->numbers = numbers;
+  stream->numbers_base = first;
+}
+
+// makes room for one more token, recycling the ones the parser is done with
+// if we are streaming
+static void
+token_stream_make_room (struct token_stream *stream)
+{
+  if (stream->count - stream->base < stream->capacity)
+    return;
+
+  if (stream->lexer || stream->lex_thread)
+    {
+      int keep = stream->cursor;
+      if (!vector_empty (stream->saves))
+        {
+          int *first_save = vector_at (stream->saves, 0);
+          keep = *first_save < keep ? *first_save : keep;
+        }
+
+      keep -= TOKEN_STREAM_KEEP_BEHIND;
+      if (keep > stream->base)
+        {
+          stream->base = keep;
+          token_stream_recycle_brackets (stream);
+          token_stream_recycle_numbers (stream);
+        }
+    }
+
+  if (stream->count - stream->base == stream->capacity)
+    {
+      token_stream_grow (stream, stream->capacity * 2);
+    }
+}
+
+// packs the value of `token' into 32 bits
+static unsigned int
+token_stream_pack_value (struct token_stream *stream, struct token *token,
+                         unsigned char *kind)
+{
+  unsigned int value = 0;
+  switch (token->type)
+    {
+    case TOKEN_TYPE_KEYWORD:
+      value = token->keyword;
+      break;
+
+    case TOKEN_TYPE_OPERATOR:
+      value = token->op;
+      break;
+
+    case TOKEN_TYPE_SYMBOL:
+      value = (unsigned char)token->cval;
+      break;
+
+    case TOKEN_TYPE_NUMBER:
+      if (token->num.flags == 0 && token->llnum <= UINT_MAX
+          && (token->num.type == NUMBER_TYPE_NORMAL
+              || token->num.type == NUMBER_TYPE_LONG))
+        {
+          *kind |= token->num.type << TOKEN_KIND_NUMBER_TYPE_SHIFT;
+          value = token->llnum;
+          break;
+        }
+
+      *kind |= TOKEN_KIND_BIG_NUMBER;
+      value = stream->numbers_base + vector_count (stream->numbers);
+      vector_push (stream->numbers,
+                   &(struct token_stream_number){ .llnum = token->llnum,
+                                                  .num = token->num });
+      break;
+
+    case TOKEN_TYPE_IDENTIFIER:
+    case TOKEN_TYPE_STRING:
+    case TOKEN_TYPE_COMMENT:
+      if (!token->sval)
+        {
+          value = token->text_len;
+          break;
+        }
+
+      *kind |= TOKEN_KIND_COPIED;
+      value = intern_id (stream->strings, token->sval);
+      break;
+    }
+
+  return value;
+}
+
+int
+token_stream_push (struct token_stream *stream, struct token *token)
+{
+  token_stream_make_room (stream);
+
+  unsigned char kind = token->type;
+  if (token->whitespace)
+    {
+      kind |= TOKEN_KIND_WHITESPACE;
+    }
+
+  int index = stream->count++;
+  int slot = token_stream_slot (stream, index);
+  stream->value[slot] = token_stream_pack_value (stream, token, &kind);
+  stream->kind[slot] = kind;
+  stream->offset[slot] = token->offset;
+  stream->len[slot] = token->len;
+  return index;
+}
+
+int
+token_stream_last (struct token_stream *stream)
+{
+  return stream->count - 1;
+}
+
+_Bool
+token_stream_ensure (struct token_stream *stream, int token)
+{
+  // the lexer may still change the last token it read (i.e. it pops the `0'
+  // of `0x10'), so we stay one token ahead of whoever is asking
+  if (stream->lexer && stream->count <= token + 1)
+    {
+      // the lexer points errors at the token it's reading, but anything the
+      // parser reports is still about the token it took last. Lexer errors
+      // jump out of here, so they keep pointing at theirs
+      struct compile_process *compiler = stream->lexer->compiler;
+      unsigned int offset = compiler->offset;
+      while (stream->lexer && stream->count <= token + 1)
+        {
+          if (!lex_next (stream->lexer))
+            stream->lexer = NULL;
+        }
+
+      compiler->offset = offset;
+    }
+
+  // tokens from another thread are already final
+  while (stream->lex_thread && stream->count <= token)
+    {
+      if (!lex_thread_next (stream->lex_thread, stream))
+        stream->lex_thread = NULL;
+    }
+
+  return token < stream->count;
+}
+
+void
+token_stream_save (struct token_stream *stream)
+{
+  vector_push (stream->saves, &stream->cursor);
+}
+
+void
+token_stream_restore (struct token_stream *stream)
+{
+  int *cursor = vector_back (stream->saves);
+  stream->cursor = *cursor;
+  vector_pop (stream->saves);
+}
+
+void
+token_stream_save_purge (struct token_stream *stream)
+{
+  vector_pop (stream->saves);
+}
+
+void
+token_stream_push_brackets (struct token_stream *stream,
+                            struct token_brackets *brackets)
+{
+  vector_push (stream->brackets, brackets);
+}
+
+int
+token_stream_type (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  return stream->kind[slot] & TOKEN_KIND_TYPE_MASK;
+}
+
+_Bool
+token_stream_whitespace (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  return stream->kind[slot] & TOKEN_KIND_WHITESPACE;
+}
+
+void
+token_stream_set_whitespace (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  stream->kind[slot] |= TOKEN_KIND_WHITESPACE;
+}
+
+int
+token_stream_keyword (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  if (token_stream_type (stream, token) != TOKEN_TYPE_KEYWORD)
+    return KEYWORD_NONE;
+
+  return stream->value[slot];
+}
+
+int
+token_stream_op (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  if (token_stream_type (stream, token) != TOKEN_TYPE_OPERATOR)
+    return OPERATOR_NONE;
+
+  return stream->value[slot];
+}
+
+char
+token_stream_cval (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  return stream->value[slot];
+}
+
+// characters before the text of a token that was left in the input, i.e.
+// the quote of a string
+static unsigned int
+token_stream_text_start (int type)
+{
+  switch (type)
+    {
+    case TOKEN_TYPE_STRING:
+      return 1;
+
+    case TOKEN_TYPE_COMMENT:
+      return 2;
+    }
+
+  return 0;
+}
+
+const char *
+token_stream_text (struct token_stream *stream, int token, size_t *len)
+{
+  int slot = token_stream_slot (stream, token);
+  if (stream->kind[slot] & TOKEN_KIND_COPIED)
+    {
+      const char *str = intern_get (stream->strings, stream->value[slot]);
+      *len = strlen (str);
+      return str;
+    }
+
+  *len = stream->value[slot];
+  return stream->source + stream->offset[slot]
+         + token_stream_text_start (token_stream_type (stream, token));
+}
+
+// copies the text of a token that's still in the input to the intern table,
+// so it can be used as a C string
+static void
+token_stream_copy_text (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  size_t len = 0;
+  const char *text = token_stream_text (stream, token, &len);
+  const char *str = intern_str (stream->strings, text, len);
+  stream->value[slot] = intern_id (stream->strings, str);
+  stream->kind[slot] |= TOKEN_KIND_COPIED;
+}
+
+const char *
+token_stream_sval (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  const char *sval = NULL;
+  switch (token_stream_type (stream, token))
+    {
+    case TOKEN_TYPE_KEYWORD:
+      sval = keyword_name (stream->value[slot]);
+      break;
+
+    case TOKEN_TYPE_OPERATOR:
+      sval = operator_name (stream->value[slot]);
+      break;
+
+    case TOKEN_TYPE_IDENTIFIER:
+    case TOKEN_TYPE_STRING:
+    case TOKEN_TYPE_COMMENT:
+      if (!(stream->kind[slot] & TOKEN_KIND_COPIED))
+        {
+          token_stream_copy_text (stream, token);
+        }
+
+      sval = intern_get (stream->strings, stream->value[slot]);
+      break;
+    }
+
+  return sval;
+}
+
+// the number of a token that didn't fit in `value', NULL if it did
+static struct token_stream_number *
+token_stream_big_number (struct token_stream *stream, int slot)
+{
+  if (!(stream->kind[slot] & TOKEN_KIND_BIG_NUMBER))
+    return NULL;
+
+  return vector_at (stream->numbers,
+                    stream->value[slot] - stream->numbers_base);
+}
+
+void
+token_stream_take (struct token_stream *stream, int token,
+                   struct token_stream_entry *entry)
+{
+  int slot = token_stream_slot (stream, token);
+  *entry = (struct token_stream_entry){ .kind = stream->kind[slot],
+                                        .offset = stream->offset[slot],
+                                        .len = stream->len[slot],
+                                        .value = stream->value[slot] };
+
+  struct token_stream_number *number = token_stream_big_number (stream, slot);
+  if (number)
+    entry->number = *number;
+
+  if (entry->kind & TOKEN_KIND_COPIED)
+    {
+      entry->sval = intern_get (stream->strings, entry->value);
+      entry->sval_len = intern_len (stream->strings, entry->sval);
+    }
+}
+
+int
+token_stream_put (struct token_stream *stream,
+                  struct token_stream_entry *entry)
+{
+  token_stream_make_room (stream);
+
+  // numbers and copied text go where this stream keeps them
+  unsigned int value = entry->value;
+  if (entry->kind & TOKEN_KIND_BIG_NUMBER)
+    {
+      value = stream->numbers_base + vector_count (stream->numbers);
+      vector_push (stream->numbers, &entry->number);
+    }
+  else if (entry->kind & TOKEN_KIND_COPIED)
+    {
+      value = intern_id (stream->strings,
+                         intern_str (stream->strings, entry->sval,
+                                     entry->sval_len));
+    }
+
+  int index = stream->count++;
+  int slot = token_stream_slot (stream, index);
+  stream->kind[slot] = entry->kind;
+  stream->offset[slot] = entry->offset;
+  stream->len[slot] = entry->len;
+  stream->value[slot] = value;
+  return index;
+}
+
+void
+token_stream_append (struct token_stream *stream, struct token_stream *from)
+{
+  assert (from->base == 0);
+
+  // strings are interned in the order `from' found them, so they get the
+  // same ids they'd have if `stream' had read its tokens itself
+  struct intern *strings = from->strings;
+  unsigned int *ids = malloc ((strings->count + 1) * sizeof (unsigned int));
+  for (size_t i = 0; i < strings->count; i++)
+    {
+      const char *str = intern_get (strings, i);
+      ids[i] = intern_id (stream->strings,
+                          intern_str (stream->strings, str,
+                                      intern_len (strings, str)));
+    }
+
+  unsigned int first_number
+      = stream->numbers_base + vector_count (stream->numbers);
+  if (!vector_empty (from->numbers))
+    vector_push_multiple (stream->numbers, vector_at (from->numbers, 0),
+                          vector_count (from->numbers));
+
+  while (stream->capacity - (stream->count - stream->base) < from->count)
+    token_stream_grow (stream, stream->capacity * 2);
+
+  for (int i = 0; i < from->count; i++)
+    {
+      int slot = (stream->count + i) & stream->mask;
+      int from_slot = i & from->mask;
+      unsigned char kind = from->kind[from_slot];
+      unsigned int value = from->value[from_slot];
+      if (kind & TOKEN_KIND_BIG_NUMBER)
+        value += first_number;
+      else if (kind & TOKEN_KIND_COPIED)
+        value = ids[value];
+
+      stream->kind[slot] = kind;
+      stream->offset[slot] = from->offset[from_slot];
+      stream->len[slot] = from->len[from_slot];
+      stream->value[slot] = value;
+    }
+
+  stream->count += from->count;
+  free (ids);
+}
+
+unsigned long long
+token_stream_llnum (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  struct token_stream_number *number = token_stream_big_number (stream, slot);
+  return number ? number->llnum : stream->value[slot];
+}
+
+double
+token_stream_dval (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  struct token_stream_number *number = token_stream_big_number (stream, slot);
+  return number ? number->dval : 0;
+}
+
+int
+token_stream_number_type (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  struct token_stream_number *number = token_stream_big_number (stream, slot);
+  if (number)
+    return number->num.type;
+
+  return (stream->kind[slot] & TOKEN_KIND_NUMBER_TYPE_MASK)
+         >> TOKEN_KIND_NUMBER_TYPE_SHIFT;
+}
+
+int
+token_stream_number_flags (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  struct token_stream_number *number = token_stream_big_number (stream, slot);
+  return number ? number->num.flags : 0;
+}
+
+unsigned int
+token_stream_offset (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  return stream->offset[slot];
+}
+
+unsigned int
+token_stream_len (struct token_stream *stream, int token)
+{
+  int slot = token_stream_slot (stream, token);
+  return stream->len[slot];
+}
+
+// text between the top level brackets `token' is in, NULL if it isn't in any
+// or the input wasn't in memory
+const char *
+token_stream_between_brackets (struct token_stream *stream, int token,
+                               size_t *len)
+{
+  struct token_brackets *brackets = vector_at (stream->brackets, 0);
+  unsigned int offset = token_stream_offset (stream, token);
+
+  // find the last pair of brackets opened before the token
+  int low = stream->brackets_base;
+  int high = vector_count (stream->brackets) - 1;
+  while (low <= high)
+    {
+      int mid = low + (high - low) / 2;
+      if (brackets[mid].open < offset)
+        low = mid + 1;
+      else
+        high = mid - 1;
+    }
+
+  if (!stream->source || high < stream->brackets_base
+      || offset >= brackets[high].close)
+    return NULL;
+
+  *len = brackets[high].close - brackets[high].open - 1;
+  return stream->source + brackets[high].open + 1;
+}